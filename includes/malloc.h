@@ -23,6 +23,69 @@ void *malloc(size_t size);
  */
 void free(void *ptr);
 
+/**
+ * @brief Frees memory whose requested size is known (C23)
+ *
+ * Same as free(ptr), size being the size passed to malloc(), calloc() or
+ * realloc(). The size picks the block's size class directly, so that fewer
+ * checks run than in free().
+ *
+ * @param ptr Pointer to memory to free
+ * @param size Size requested for ptr
+ */
+void free_sized(void *ptr, size_t size);
+
+/**
+ * @brief Frees aligned memory whose requested size is known (C23)
+ *
+ * Same as free_sized() for memory returned by aligned_alloc() and the
+ * other aligned allocation functions.
+ *
+ * @param ptr Pointer to memory to free
+ * @param alignment Alignment requested for ptr
+ * @param size Size requested for ptr
+ */
+void free_aligned_sized(void *ptr, size_t alignment, size_t size);
+
+/**
+ * @brief Gets the number of usable bytes of an allocation
+ *
+ * The result is at least the requested size; every byte of it may be used
+ * until the memory is freed or reallocated.
+ *
+ * @param ptr Pointer to allocated memory
+ * @return size_t Usable bytes at ptr, 0 if ptr is NULL or not allocated
+ */
+size_t malloc_usable_size(void *ptr);
+
+/**
+ * @brief Allocates count blocks of the same size at once
+ *
+ * Takes the allocator lock once for the whole batch instead of once per
+ * block, and carves consecutive blocks out of the same free memory. Every
+ * block is released with free() or free_batch().
+ *
+ * @param size Size in bytes of each block
+ * @param count Number of blocks to allocate
+ * @param ptrs Array of at least count pointers receiving the blocks
+ * @return size_t Number of blocks allocated, stored at the start of ptrs;
+ * less than count when memory runs out
+ */
+size_t malloc_batch(size_t size, size_t count, void **ptrs);
+
+/**
+ * @brief Frees count blocks at once
+ *
+ * Takes the allocator lock once for the whole batch, and does the upkeep
+ * of each zone once per run of blocks from that zone rather than once per
+ * block. Blocks allocated together are best freed together, in the same
+ * order. NULL pointers are ignored.
+ *
+ * @param ptrs Array of count pointers to free
+ * @param count Number of pointers in ptrs
+ */
+void free_batch(void **ptrs, size_t count);
+
 /**
  * @brief Changes the size of a previously allocated memory block
  *
@@ -50,6 +113,56 @@ void *realloc(void *ptr, size_t size);
  */
 void *calloc(size_t nmemb, size_t size);
 
+/**
+ * @brief Allocates memory aligned on a power of two
+ *
+ * This function allocates size bytes whose address is a multiple of
+ * alignment and stores it in *memptr. The memory is released with free().
+ *
+ * @param memptr Where to store the pointer to the allocated memory
+ * @param alignment Power of two, multiple of sizeof(void *)
+ * @param size Size in bytes to allocate
+ * @return int 0 on success, EINVAL for a bad alignment, ENOMEM on failure
+ */
+int posix_memalign(void **memptr, size_t alignment, size_t size);
+
+/**
+ * @brief Allocates memory aligned on a power of two (C11)
+ *
+ * @param alignment Power of two
+ * @param size Size in bytes to allocate
+ * @return void* Pointer to the allocated memory, NULL on failure or if
+ * alignment is not a power of two
+ */
+void *aligned_alloc(size_t alignment, size_t size);
+
+/**
+ * @brief Allocates memory aligned on alignment (obsolete)
+ *
+ * An alignment that is not a power of two is rounded up to the next one.
+ *
+ * @param alignment Requested alignment
+ * @param size Size in bytes to allocate
+ * @return void* Pointer to the allocated memory, NULL on failure
+ */
+void *memalign(size_t alignment, size_t size);
+
+/**
+ * @brief Allocates page-aligned memory (obsolete)
+ *
+ * @param size Size in bytes to allocate
+ * @return void* Pointer to the allocated memory, NULL on failure
+ */
+void *valloc(size_t size);
+
+/**
+ * @brief Allocates page-aligned memory rounded up to whole pages (obsolete)
+ *
+ * @param size Size in bytes to allocate, at least one page is allocated
+ * @return void* Pointer to the allocated memory, NULL on failure
+ */
+void *pvalloc(size_t size);
+
 /**
  * @brief Displays information about allocated memory
  *
@@ -60,6 +173,18 @@ void *calloc(size_t nmemb, size_t size);
  */
 void show_alloc_mem(void);
 
+/**
+ * @brief Same output as show_alloc_mem(), with the arenas locked only while
+ * they are copied
+ *
+ * Each arena in turn is locked just long enough to copy the address ranges
+ * of its zones and blocks into a private mapping; the copy is formatted
+ * and written after the lock is released, so that other threads keep
+ * allocating meanwhile. Each arena is consistent on its own, but the
+ * arenas are copied at different times.
+ */
+void show_alloc_mem_snapshot(void);
+
 /**
  * @brief Extended version of show_alloc_mem with more details (bonus)
  *
@@ -71,4 +196,134 @@ void show_alloc_mem(void);
  */
 void show_alloc_mem_ex(void);
 
+/* ft_mallopt() parameters */
+/* Blocks visited by the coalescing work attached to one free (0: none) */
+#define FT_M_COALESCE_BUDGET 1
+/* Fragmentation score, in hundredths, that queues a zone for coalescing */
+#define FT_M_FRAG_THRESHOLD 2
+/* Bytes of freed LARGE mappings kept for reuse (0 disables the cache) */
+#define FT_M_LARGE_CACHE_MAX 3
+/* Milliseconds after which an unused cached LARGE mapping is unmapped */
+#define FT_M_LARGE_CACHE_DECAY 4
+/* Back SMALL zones and LARGE zones of 2 MB or more with huge pages (0 or 1) */
+#define FT_M_HUGE_PAGES 5
+/* Free pages an arena accumulates before handing them back to the kernel */
+#define FT_M_PURGE_THRESHOLD 6
+/* Empty TINY/SMALL zones each arena keeps mapped instead of unmapping */
+#define FT_M_RETAIN_ZONES 7
+/* Hand coalescing and purging to a background thread (0 or 1) */
+#define FT_M_BACKGROUND_THREAD 8
+/* Milliseconds over which the background thread releases freed memory */
+#define FT_M_DECAY_TIME 9
+
+/**
+ * @brief Tunes the allocator, in the spirit of mallopt(3)
+ *
+ * @param param One of the FT_M_* parameters
+ * @param value New value of the parameter, must not be negative
+ * @return int 1 on success, 0 if param or value is invalid
+ */
+int ft_mallopt(int param, int value);
+
+/* Byte counters of the zones of one type, see ft_malloc_stats() */
+typedef struct s_malloc_zone_stats {
+	size_t zones;         /* Zones mapped */
+	size_t mapped;        /* Bytes mapped for them */
+	size_t active;        /* Bytes of allocated blocks, thread caches included */
+	size_t free;          /* Bytes of free blocks and objects */
+	size_t free_blocks;   /* Number of free blocks and objects */
+	size_t metadata;      /* Bytes of headers, slab bitmaps and padding */
+	size_t fragmentation; /* Free bytes outside the largest free block of each
+	                         zone, or in TINY slabs still holding objects */
+} t_malloc_zone_stats;
+
+/* State of the allocator, see ft_malloc_stats() */
+typedef struct s_malloc_stats {
+	t_malloc_zone_stats tiny;  /* TINY slabs */
+	t_malloc_zone_stats small; /* SMALL zones */
+	t_malloc_zone_stats large; /* LARGE zones, one per allocation */
+	t_malloc_zone_stats total; /* Sum of the three */
+	size_t arenas;             /* Arenas in use */
+	size_t large_cache;        /* Bytes of freed LARGE mappings kept for reuse */
+	size_t dirty;  /* Bytes of free pages not handed back to the kernel yet */
+	size_t purged; /* Bytes handed back to the kernel so far */
+} t_malloc_stats;
+
+/* Same layout as the glibc structure, see mallinfo2(3) */
+struct mallinfo2 {
+	size_t arena;    /* Bytes of the TINY and SMALL zones */
+	size_t ordblks;  /* Free blocks and objects in them */
+	size_t smblks;   /* Unused, 0 */
+	size_t hblks;    /* LARGE zones */
+	size_t hblkhd;   /* Bytes of the LARGE zones */
+	size_t usmblks;  /* Unused, 0 */
+	size_t fsmblks;  /* Unused, 0 */
+	size_t uordblks; /* Bytes allocated in the TINY and SMALL zones */
+	size_t fordblks; /* Bytes free in the TINY and SMALL zones */
+	size_t keepcost; /* Bytes of free pages that can go back to the kernel */
+};
+
+/**
+ * @brief Gets the state of the allocator
+ *
+ * The counters are kept up to date by every allocation and free: the heap
+ * is not walked, and each arena is only locked for as long as it takes to
+ * copy its counters.
+ *
+ * @return t_malloc_stats Bytes mapped, allocated, free, spent on metadata
+ * and lost to fragmentation, per zone type
+ */
+t_malloc_stats ft_malloc_stats(void);
+
+/**
+ * @brief Gets the state of the allocator, in the spirit of mallinfo2(3)
+ *
+ * @return struct mallinfo2 The ft_malloc_stats() counters under their glibc
+ * names
+ */
+struct mallinfo2 mallinfo2(void);
+
+/**
+ * @brief Writes the ft_malloc_stats() counters as a JSON object
+ *
+ * Like snprintf(), at most size bytes are written, the last one being the
+ * terminating null byte.
+ *
+ * @param buffer Where to write the JSON text, may be NULL if size is 0
+ * @param size Size of buffer
+ * @return size_t Length of the whole JSON text, without the null byte
+ */
+size_t ft_malloc_stats_json(char *buffer, size_t size);
+
+/**
+ * @brief Writes the ft_malloc_stats() counters as a JSON object to a file
+ *
+ * @param fd File descriptor to write to
+ * @return int 0 on success, -1 if the write failed
+ */
+int ft_malloc_stats_json_fd(int fd);
+
+/**
+ * @brief Runs deferred maintenance work on every arena
+ *
+ * Finishes the pending coalescing passes without any work budget, hands
+ * every free page back to the kernel and unmaps the cached LARGE mappings
+ * that have decayed. Meant to be called at a convenient time, e.g. when the
+ * program is idle.
+ */
+void ft_malloc_maintenance(void);
+
+/**
+ * @brief Checks the counters of the allocator against the heap itself
+ *
+ * Walks every block and slab of every arena, and compares what it finds with
+ * the counters that ft_malloc_stats() and the allocation paths rely on. Each
+ * arena stays locked during its walk, so this is meant for tests and
+ * debugging rather than for monitoring.
+ *
+ * @return int Number of counters that disagree with the walk, 0 when the
+ * heap is consistent
+ */
+int ft_malloc_check(void);
+
 #endif
@@ -1,6 +1,7 @@
 #ifndef FT_MALLOC_INTERNAL_H
 #define FT_MALLOC_INTERNAL_H
 #include "bool.h"
+#include "trace.h"
 #include <limits.h>
 #include <pthread.h>
 #include <stdbool.h>
@@ -18,6 +19,11 @@
 #define DEBUG_MALLOC 0
 #endif
 
+/* Records each thread buffers before its trace ring is written out */
+#define TRACE_RING_RECORDS 4096
+/* Period of the thread writing the trace rings out */
+#define TRACE_FLUSH_INTERVAL_MS 100
+
 /* Tiny size */
 #define TINY_MAX_SIZE 128
 /* Small size */
@@ -26,6 +32,45 @@
 #define MIN_ALLOC_PER_ZONE 100
 /* Magic number of freed memory */
 #define MAGIC_NUMBER 0xDEADBEEF
+/* Magic number of SMALL blocks parked in a thread cache */
+#define TCACHE_MAGIC 0xCAC4EB10
+/* Magic number of SMALL/LARGE blocks queued for their owning arena */
+#define REMOTE_MAGIC 0x4E307EF7
+/* Arenas created per online CPU */
+#define ARENAS_PER_CPU 4
+/* Default for FT_M_COALESCE_BUDGET */
+#define DEFAULT_COALESCE_BUDGET 64
+/* Default for FT_M_FRAG_THRESHOLD (a fragmentation score of 1.5) */
+#define DEFAULT_FRAG_THRESHOLD 150
+/* Default for FT_M_LARGE_CACHE_MAX */
+#define DEFAULT_LARGE_CACHE_MAX (64UL * 1024 * 1024)
+/* Default for FT_M_LARGE_CACHE_DECAY */
+#define DEFAULT_LARGE_CACHE_DECAY 10000
+/* Default for FT_M_HUGE_PAGES (regular pages) */
+#define DEFAULT_HUGE_PAGES 0
+/* Default for FT_M_PURGE_THRESHOLD (2 MB of 4 KB pages) */
+#define DEFAULT_PURGE_THRESHOLD 512
+/* Default for FT_M_RETAIN_ZONES */
+#define DEFAULT_RETAIN_ZONES 2
+/* Default for FT_M_BACKGROUND_THREAD (no thread) */
+#define DEFAULT_BACKGROUND_THREAD 0
+/* Default for FT_M_DECAY_TIME */
+#define DEFAULT_DECAY_TIME 10000
+/* Background purger ticks per decay time */
+#define DECAY_STEPS 10
+/* calloc() drops the pages of a reused block this large instead of
+ * clearing them */
+#define CALLOC_DONTNEED_MIN (256 * 1024)
+/* block_memcpy() and block_memset() bypass the caches from this size, when
+ * the size of the last level cache is unknown */
+#define BLOCK_NT_THRESHOLD (8UL * 1024 * 1024)
+/* Output of show_alloc_mem() and show_alloc_mem_ex() is written in chunks
+ * of this size */
+#define SHOW_BUFFER_SIZE (64 * 1024)
+/* Size buckets of the LARGE mapping cache */
+#define LARGE_CACHE_BUCKETS 64
+/* Upper bound on the number of arenas */
+#define MAX_ARENAS 64
 
 /* Standard 16-byte memory alignment */
 #define MALLOC_ALIGNMENT 16
@@ -34,15 +79,23 @@
 	(((size) + (MALLOC_ALIGNMENT - 1)) & ~(MALLOC_ALIGNMENT - 1))
 /* Page size using sysconf(_SC_PAGESIZE) for Linux */
 #define PAGE_SIZE (sysconf(_SC_PAGESIZE))
+/* Macro to round size up to a whole number of pages */
+#define PAGE_ALIGN(size) (((size) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+/* Macro to round an address down to the start of its page */
+#define PAGE_FLOOR(addr) ((uintptr_t)(addr) & ~(uintptr_t)(PAGE_SIZE - 1))
+/* Size of the huge pages backing zones when FT_M_HUGE_PAGES is set */
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+/* Macro to round size up to a whole number of huge pages */
+#define HUGE_ALIGN(size) (((size) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1))
 /* Zone size calculations for pre-allocation */
 #define TINY_ZONE_SIZE                                                         \
 	(PAGE_SIZE * ((TINY_MAX_SIZE * MIN_ALLOC_PER_ZONE) / PAGE_SIZE + 1))
 #define SMALL_ZONE_SIZE                                                        \
 	(PAGE_SIZE * ((SMALL_MAX_SIZE * MIN_ALLOC_PER_ZONE) / PAGE_SIZE + 1))
 /* Block size calculations */
-#define BLOCK_METADATA_SIZE                                                    \
-	(sizeof(struct s_block *) + sizeof(struct s_block *) + sizeof(size_t) +      \
-	 sizeof(uint32_t) + sizeof(t_bool) + sizeof(size_t))
+/* One MALLOC_ALIGNMENT unit, so every user pointer stays aligned */
+#define BLOCK_METADATA_SIZE (sizeof(t_block))
+#define ZONE_HEADER_SIZE (ALIGN(sizeof(t_zone)))
 #define BLOCK_TOTAL_SIZE(user_size) (ALIGN(BLOCK_METADATA_SIZE + (user_size)))
 
 /* Get appropriate zone type for allocation size */
@@ -51,89 +104,649 @@
 	 : (size <= SMALL_MAX_SIZE) ? ZONE_SMALL                                     \
 	                            : ZONE_LARGE)
 
-/* Calculate total size needed for a user allocation */
-#define CALC_NEEDED_SIZE(user_size) (BLOCK_TOTAL_SIZE(user_size))
+/* Calculate the data size of the block serving a user allocation */
+#define CALC_NEEDED_SIZE(user_size) (ALIGN(user_size))
+
+/* TINY slabs: one size class per MALLOC_ALIGNMENT step up to TINY_MAX_SIZE */
+#define TINY_CLASSES (TINY_MAX_SIZE / MALLOC_ALIGNMENT)
+/* Size class index of a TINY allocation */
+#define TINY_CLASS(size) (ALIGN(size) / MALLOC_ALIGNMENT - 1)
+/* Objects tracked by one slab: a 64-bit summary over 64-bit bitmap words */
+#define SLAB_MAX_OBJECTS (64 * 64)
+
+/* Page map granularity and covered address bits */
+#define PAGEMAP_SHIFT 12
+#define PAGEMAP_ADDRESS_BITS 48
+/* Entries per leaf of the page map */
+#define PAGEMAP_LEAF_BITS 18
+#define PAGEMAP_ROOT_BITS                                                      \
+	(PAGEMAP_ADDRESS_BITS - PAGEMAP_SHIFT - PAGEMAP_LEAF_BITS)
+
+/* Largest block size served by the thread caches (TINY and SMALL zones) */
+#define TCACHE_MAX_SIZE SMALL_MAX_SIZE
+/* One thread cache bin per MALLOC_ALIGNMENT step */
+#define TCACHE_BINS (TCACHE_MAX_SIZE / MALLOC_ALIGNMENT + 1)
+/* Maximum number of blocks kept in a single bin */
+#define TCACHE_MAX_COUNT 16
+/* Thread cache bin index for a block size */
+#define TCACHE_INDEX(size) ((size) / MALLOC_ALIGNMENT)
+/*
+ * Bins 1 to TINY_CLASSES hold header-less TINY objects, higher bins hold
+ * SMALL blocks (whose data size always exceeds TINY_MAX_SIZE)
+ */
+#define TCACHE_IS_TINY(index) ((index) <= TINY_CLASSES)
+
+/* Free-list bins per SMALL/LARGE zone, tracked by a 64-bit bitmap */
+#define FREE_BINS 64
+/* Below this size every MALLOC_ALIGNMENT step has its own exact bin */
+#define FREE_BINS_EXACT_LIMIT 512
+/* Free-list links of a free block, stored in its (unused) data area */
+#define FREE_LINKS(block)                                                      \
+	((t_free_links *)((char *)(block) + BLOCK_METADATA_SIZE))
+
+/* Flag bits kept in the low bits of t_block.size (sizes are aligned) */
+#define BLOCK_FREE 0x1
+/* Free block whose whole pages were handed back to the kernel */
+#define BLOCK_PURGED 0x2
+/* Free block known to read as zero: its whole pages if BLOCK_PURGED is
+ * set too, otherwise its whole data area past the free-list links */
+#define BLOCK_ZEROED 0x4
+#define BLOCK_FLAGS (MALLOC_ALIGNMENT - 1)
+/* Size of the data area of a block, without its flag bits */
+#define BLOCK_SIZE(block) ((block)->size & ~(size_t)BLOCK_FLAGS)
+#define BLOCK_IS_FREE(block) (((block)->size & BLOCK_FREE) != 0)
+/* User data area following a block header */
+#define BLOCK_DATA(block) ((void *)((char *)(block) + BLOCK_METADATA_SIZE))
+/* Zone holding a header block, found through the page map */
+#define BLOCK_ZONE(block) (pagemap_lookup(block))
 
 /* Zone types */
 typedef enum { ZONE_TINY, ZONE_SMALL, ZONE_LARGE } zone_type_t;
+/* Number of zone types, used to size per-type arrays */
+#define ZONE_TYPES (ZONE_LARGE + 1)
 
 /*
  * Memory block header structure
- * Must be aligned to ensure proper alignment of user data
+ * Exactly MALLOC_ALIGNMENT bytes so that user data stays aligned. Blocks
+ * tile their zone, so the next block starts right after the data area and
+ * only the previous one needs a link.
  */
 typedef struct s_block {
-	struct s_block *next; /* Next block in the zone */
-	struct s_block *prev; /* Previous block in the zone */
-	size_t size;          /* Size of the data area */
-	uint32_t magic;       /* Magic number for validation */
-	t_bool is_free;       /* Indicates if block is free */
-	size_t offset;        /* Offset from start of zone */
-	char padding[0];      /* Start of user data */
+	size_t size;    /* Size of the data area, low bits hold BLOCK_* flags */
+	uint32_t prev;  /* Zone offset of the previous block, 0 for the first */
+	uint32_t magic; /* Magic number for validation */
 } t_block;
 
+_Static_assert(sizeof(t_block) == MALLOC_ALIGNMENT,
+               "block headers must keep user data aligned");
+
+/*
+ * Links of a free block in its zone's free-list bin
+ */
+typedef struct s_free_links {
+	t_block *next; /* Next free block of the same bin */
+	t_block *prev; /* Previous free block of the same bin */
+} t_free_links;
+
 /*
  * Zone structure - manages a contiguous memory region
  */
 typedef struct s_zone {
-	void *start;         /* Start address of zone memory */
-	size_t total_size;   /* Total zone size in bytes */
-	zone_type_t type;    /* Zone type (TINY, SMALL, LARGE) */
-	struct s_zone *next; /* Next zone in list */
-	size_t free_space;   /* Available space in zone */
-	size_t used_blocks;  /* Number of allocated blocks */
-	t_block *blocks;     /* Pointer to first block in zone */
+	void *start;                /* Start address of zone memory */
+	size_t total_size;          /* Total zone size in bytes */
+	zone_type_t type;           /* Zone type (TINY, SMALL, LARGE) */
+	struct s_zone *next;        /* Next zone in list */
+	struct s_zone *prev;        /* Previous zone in list */
+	size_t free_space;          /* Available space in zone */
+	size_t used_blocks;         /* Number of allocated blocks */
+	t_block *blocks;            /* Pointer to first block in zone */
+	struct s_arena *arena;      /* Arena owning this zone */
+	void *remote_free;          /* Blocks freed by other threads (atomic) */
+	struct s_zone *remote_next; /* Next zone with pending remote frees */
+	size_t remote_pending;      /* Pushes in flight or queued (atomic) */
+	/* Empty zone state */
+	t_bool retained;            /* Counted in the arena's empty_zones */
+	t_bool purged;              /* Empty slab whose pages were purged */
+	size_t empty_since;         /* Purger epoch at which it was retained */
+	t_bool release_deferred;    /* Release refused while remote frees were
+	                               in flight, retried by the owner */
+	/* TINY slab state: fixed-size objects without headers */
+	size_t slab_size;           /* Object size of the slab */
+	size_t slab_capacity;       /* Number of objects in the slab */
+	uint64_t slab_summary;      /* Bit i set when slab_bitmap[i] is not 0 */
+	uint64_t *slab_bitmap;      /* One bit per object, set when free */
+	uint64_t *slab_parked;      /* One bit per object, set while parked in a
+	                               thread cache or remote list (atomic) */
+	char *slab_objects;         /* Address of the first object */
+	struct s_zone *slab_prev;   /* Previous slab with free objects */
+	struct s_zone *slab_next;   /* Next slab with free objects */
+	/* Free blocks of SMALL/LARGE zones, segregated by size */
+	uint64_t free_map;             /* Bit i set when free_bins[i] is not empty */
+	t_block *free_bins[FREE_BINS]; /* Heads of the free-list bins */
+	size_t free_count;             /* Number of binned free blocks */
+	size_t total_free;             /* Data bytes of the binned free blocks */
+	size_t largest_free;           /* Data size of the largest free block */
+	/* Deferred coalescing state */
+	t_bool defrag_queued;          /* Set while in the arena's defrag queue */
+	size_t defrag_cursor;          /* Offset where the pass resumes, 0: start */
+	struct s_zone *defrag_next;    /* Next zone waiting for coalescing */
+	/* Position in the arena's index of zones with free blocks */
+	size_t index_bin;              /* Highest non-empty bin, FREE_BINS if none */
+	struct s_zone *index_prev;     /* Previous zone with the same index_bin */
+	struct s_zone *index_next;     /* Next zone with the same index_bin */
 } t_zone;
 
+/*
+ * Counters of the zones of one type in an arena, kept up to date as zones
+ * and blocks come and go. The bytes handed out are what the mapped bytes
+ * leave to neither the metadata nor the free blocks
+ */
+typedef struct s_zone_stats {
+	size_t zones;       /* Zones mapped */
+	size_t mapped;      /* Bytes of their mappings */
+	size_t metadata;    /* Zone and block headers, slab bitmaps and padding */
+	size_t free;        /* Data bytes of the free blocks and objects */
+	size_t free_blocks; /* Free blocks and objects */
+	size_t fragmented;  /* Free bytes outside the largest free block of each
+	                       zone, or in slabs still holding objects */
+} t_zone_stats;
+
+/* Counters of the type of a zone, in its arena */
+#define ZONE_STATS(zone) (&(zone)->arena->stats[(zone)->type])
+
+/*
+ * Arena structure - independent heap with its own zones and lock
+ * Threads are bound to an arena round-robin on their first allocation.
+ */
+typedef struct s_arena {
+	pthread_mutex_t mutex;       /* Protects every zone of the arena */
+	t_zone *zones;               /* Head of the arena's zones list */
+	size_t index;                /* Position in g_arenas */
+	size_t lock_count;           /* Number of times the lock was taken */
+	size_t contended;            /* Acquisitions that had to wait for the lock */
+	t_zone *remote_zones;        /* Zones with pending remote frees (atomic) */
+	t_zone *slabs[TINY_CLASSES]; /* Slabs with free objects, per size class */
+	/* Zones with free blocks, per type, bucketed by highest non-empty bin */
+	uint64_t zone_map[ZONE_TYPES];             /* Bit i set when bucket i used */
+	t_zone *zone_index[ZONE_TYPES][FREE_BINS]; /* Buckets of zones */
+	t_zone *defrag_zones;                      /* Zones waiting for coalescing */
+	/* Returning memory to the kernel */
+	size_t dirty_pages;    /* Free pages not purged, since the last purge */
+	size_t purged_pages;   /* Pages handed back with madvise() */
+	size_t empty_zones;    /* Empty TINY/SMALL zones kept mapped */
+	size_t released_zones; /* Empty zones unmapped */
+	size_t deferred_releases; /* Zones with release_deferred set */
+	/* Dirty pages added during each of the last purger ticks */
+	size_t decay_dirty[DECAY_STEPS]; /* Ring indexed by purger epoch */
+	size_t decay_last;               /* dirty_pages after the last tick */
+	t_zone_stats stats[ZONE_TYPES];  /* Counters per zone type */
+} t_arena;
+
+/*
+ * Per-thread cache of recently freed TINY/SMALL blocks
+ * Cached blocks stay allocated from the zone's point of view; the first word
+ * of their user data links them together.
+ */
+typedef struct s_tcache {
+	void *bins[TCACHE_BINS];          /* Cached user pointers per size class */
+	unsigned int counts[TCACHE_BINS]; /* Number of blocks in each bin */
+	t_bool registered;                /* Exit destructor is armed */
+	t_bool disabled;                  /* Thread is exiting, bypass the cache */
+} t_tcache;
+
+/*
+ * Tunables set through ft_mallopt(), read with relaxed atomics
+ */
+typedef struct s_options {
+	size_t coalesce_budget;   /* FT_M_COALESCE_BUDGET */
+	size_t frag_threshold;    /* FT_M_FRAG_THRESHOLD */
+	size_t large_cache_max;   /* FT_M_LARGE_CACHE_MAX */
+	size_t large_cache_decay; /* FT_M_LARGE_CACHE_DECAY */
+	size_t huge_pages;        /* FT_M_HUGE_PAGES */
+	size_t purge_threshold;   /* FT_M_PURGE_THRESHOLD */
+	size_t retain_zones;      /* FT_M_RETAIN_ZONES */
+	size_t background_thread; /* FT_M_BACKGROUND_THREAD */
+	size_t decay_time;        /* FT_M_DECAY_TIME */
+} t_options;
+
+/*
+ * Freed LARGE mapping waiting in the cache for reuse
+ * The header lives at the start of the mapping itself
+ */
+typedef struct s_cached_region {
+	size_t size;                   /* Length of the mapping */
+	size_t freed_at;               /* Monotonic time of the free, in ms */
+	struct s_cached_region *next;  /* Next region of the same bucket */
+	struct s_cached_region *prev;  /* Previous region of the same bucket */
+	struct s_cached_region *newer; /* Next region in free order */
+	struct s_cached_region *older; /* Previous region in free order */
+} t_cached_region;
+
+/*
+ * Counters of the LARGE mapping cache
+ */
+typedef struct s_large_cache_stats {
+	size_t hits;      /* LARGE zones served from the cache */
+	size_t misses;    /* LARGE zones that needed a new mapping */
+	size_t evictions; /* Cached regions unmapped by the cap or the decay */
+	size_t regions;   /* Regions currently cached */
+	size_t bytes;     /* Bytes currently cached */
+} t_large_cache_stats;
+
 /* Global variables */
-extern t_zone *g_zones;                /* Head of zones list */
-extern pthread_mutex_t g_malloc_mutex; /* Mutex for thread safety */
+extern t_arena g_arenas[MAX_ARENAS]; /* Arena table */
+extern size_t g_arena_count;         /* Number of arenas in use */
+extern t_options g_options;          /* Allocator tunables */
+
+/**
+ * Record a memory allocation operation in the trace of the calling thread
+ * Only debug builds (DEBUG_MALLOC=1) and processes started with
+ * FT_MALLOC_TRACE set trace; the others return at once
+ */
+void trace_event(t_trace_op op, void *ptr, size_t size, size_t arg);
+
+// Arena functions
+/**
+ * Get the arena bound to the calling thread, binding one if needed
+ */
+t_arena *get_thread_arena(void);
+
+/**
+ * Lock an arena, counting the acquisition and any contention
+ */
+void arena_lock(t_arena *arena);
+
+/**
+ * Unlock an arena
+ */
+void arena_unlock(t_arena *arena);
+
+// Remote free functions
+/**
+ * Queue a verified block, or a TINY object parked with slab_park(), on its
+ * zone for the owning arena to release
+ * Lock-free; used when the calling thread is bound to another arena
+ */
+void remote_free_push(t_zone *zone, void *ptr);
+
+/**
+ * Release every block queued on the arena by other threads
+ * Caller must hold the arena lock
+ */
+void remote_free_drain(t_arena *arena);
+
+// TINY slab functions
+/**
+ * Allocate an object of a TINY size class from the arena's slabs
+ * Caller must hold the arena lock
+ */
+void *slab_alloc(t_arena *arena, size_t size);
 
 /**
- * Log memory allocation operation
+ * Return an object to its slab
+ * Returns FALSE if ptr is not an allocated object of the slab, or is parked
+ * Caller must hold the slab's arena lock
  */
-void logger(const char *operation, void *ptr, size_t size);
+t_bool slab_free(t_zone *zone, void *ptr);
+
+/**
+ * Check that ptr is the start of an allocated object of the slab
+ */
+t_bool slab_owns(t_zone *zone, void *ptr);
+
+/**
+ * Mark an object of the slab as parked in a thread cache or a remote free
+ * list, where slab_free() leaves it alone; TINY objects have no header, so
+ * this state is kept beside the slab's bitmap
+ * Returns FALSE if the object already was parked
+ * ptr must be the start of an object; any thread may call this
+ */
+t_bool slab_park(t_zone *zone, void *ptr);
+
+/**
+ * Clear the parked mark of an object taken back from a cache or remote list
+ */
+void slab_unpark(t_zone *zone, void *ptr);
+
+/**
+ * Check whether object index of the slab is parked
+ */
+t_bool slab_is_parked(t_zone *zone, size_t index);
+
+/**
+ * Take a slab out of its arena's list of slabs with free objects
+ */
+void slab_unlink(t_arena *arena, t_zone *zone);
+
+// Page map functions
+/**
+ * Record the pages of a zone so pagemap_lookup() can find it
+ * (only the pages of a LARGE zone up to the start of its block's data)
+ * Returns FALSE if the page map could not grow
+ */
+t_bool pagemap_register(t_zone *zone);
+
+/**
+ * Forget every page of a zone before it is unmapped
+ */
+void pagemap_unregister(t_zone *zone);
+
+/**
+ * Same as pagemap_register() for a zone whose mapping will live at start,
+ * e.g. the target of a moved mapping
+ */
+t_bool pagemap_register_at(t_zone *zone, void *start);
+
+/**
+ * Same as pagemap_unregister() for a zone whose mapping lived at start
+ */
+void pagemap_unregister_at(t_zone *zone, void *start);
+
+/**
+ * Lock-free lookup of the registered zone containing ptr
+ */
+t_zone *pagemap_lookup(void *ptr);
+
+// LARGE mapping cache functions
+/**
+ * Take a cached mapping of at least *size bytes for a new LARGE zone
+ * Sets *size to the length of the mapping; returns NULL on a miss
+ */
+void *large_cache_get(size_t *size);
+
+/**
+ * Keep a LARGE mapping for reuse, or unmap it if the cache is disabled or
+ * the region does not fit under the byte cap
+ */
+void large_cache_put(void *start, size_t size);
+
+/**
+ * Unmap the cached regions older than the decay delay
+ */
+void large_cache_decay(void);
+
+/**
+ * Copy the cache counters into stats
+ */
+void large_cache_get_stats(t_large_cache_stats *stats);
 
 // Zone management functions
 /**
- * Create a new zone of specified type and size
+ * Create a new zone of specified type and size in an arena
+ */
+t_zone *create_zone(t_arena *arena, zone_type_t type, size_t size);
+
+/**
+ * Create a LARGE zone whose block holds size bytes starting on an alignment
+ * boundary (a power of two). The block is placed in the first page for
+ * alignments up to the page size, the mapping itself is aligned above
+ */
+t_zone *create_aligned_zone(t_arena *arena, size_t size, size_t alignment);
+
+/**
+ * Resize the mapping of a LARGE zone so that its block holds size bytes,
+ * in place when the neighbouring pages allow it, moved without copying
+ * otherwise. Returns the zone (possibly at a new address), NULL on failure
+ * Caller must hold the arena lock
+ */
+t_zone *zone_resize(t_zone *zone, size_t size);
+
+/**
+ * Move a zone to the index bucket of its highest non-empty free-list bin,
+ * or drop it from the index when it has no free block left
+ */
+void zone_index_update(t_zone *zone);
+
+/**
+ * Drop a zone from its arena's index before it is unmapped
+ */
+void zone_index_remove(t_zone *zone);
+
+/**
+ * Called when a zone is about to serve an allocation while empty
+ */
+void zone_reuse(t_zone *zone);
+
+/**
+ * Keep a zone that has just become empty mapped if the arena retains
+ * fewer than FT_M_RETAIN_ZONES empty zones. Returns FALSE otherwise
+ */
+t_bool zone_retain(t_zone *zone);
+
+/**
+ * Unmap an empty zone, or hand a LARGE one to the LARGE cache
+ * Returns FALSE, keeping the zone, while a remote free may still reach it;
+ * the release is then retried by zone_release_deferred()
+ * Caller must hold the arena lock
+ */
+t_bool zone_release(t_zone *zone);
+
+/**
+ * Retry the releases zone_release() refused, for the zones no remote free
+ * can reach anymore and that are still empty
+ * Caller must hold the arena lock
+ */
+void zone_release_deferred(t_arena *arena);
+
+/**
+ * Find appropriate zone of an arena for an allocation
+ * Picks a zone through the index of zones with free blocks, in O(1)
+ * Caller must hold the arena lock
  */
-t_zone *create_zone(zone_type_t type, size_t size);
+t_zone *find_zone_for_size(t_arena *arena, size_t size);
 
 /**
- * Find appropriate zone for an allocation
+ * Same as find_zone_for_size() in the zones of a given type, whatever the
+ * type size would get
  */
-t_zone *find_zone_for_size(size_t size);
+t_zone *find_zone_of_type(t_arena *arena, zone_type_t type, size_t size);
 
 /**
- * Find a zone containing a specific pointer
+ * Find the zone owning a pointer returned by malloc, in any arena
+ * Lock-free O(1) lookup through the page map
  */
 t_zone *find_zone_containing(void *ptr);
 
+/**
+ * Release a verified block back to its zone
+ * Caller must hold the zone's arena lock
+ */
+void free_block(t_zone *zone, t_block *block);
+
+/**
+ * Allocate size bytes like malloc(), cleared when zero is set
+ */
+void *alloc_memory(size_t size, t_bool zero);
+
+/**
+ * Release a non-NULL pointer like free(), without tracing it
+ */
+void free_memory(void *ptr);
+
+/**
+ * Release pointers like free_batch(), without tracing them, taking the
+ * lock of the calling thread's arena once; the thread cache takes them
+ * first only if cache is set
+ */
+void free_memory_batch(void **ptrs, size_t count, t_bool cache);
+
+/**
+ * Allocate size bytes starting on an alignment boundary, alignment being a
+ * power of two
+ */
+void *alloc_aligned(size_t alignment, size_t size);
+
+// Thread cache functions
+/**
+ * Take a cached block able to hold needed_size bytes
+ * Returns the user pointer, or NULL on a cache miss
+ */
+void *tcache_get(size_t needed_size);
+
+/**
+ * Park a freed pointer in the calling thread's cache
+ * Returns FALSE if the block is not cacheable and must take the slow path;
+ * a TINY object already parked by any thread is ignored
+ */
+t_bool tcache_put(void *ptr);
+
+/**
+ * Same as tcache_put() while the block's bin has room; returns FALSE rather
+ * than draining a full bin, leaving the block to the caller
+ */
+t_bool tcache_put_spare(void *ptr);
+
+/**
+ * Same as tcache_put() for a block known to hold needed_size bytes, as
+ * told by a sized free. Its zone and size are checked instead of its
+ * ownership, anything unexpected falls back to tcache_put()
+ */
+t_bool tcache_put_sized(void *ptr, size_t needed_size);
+
+/**
+ * Return every block of the calling thread's cache to its zone
+ */
+void tcache_flush(void);
+
 // Defragmentation functions
 /**
- * Calculate fragmentation metrics for a zone
- * Returns a fragmentation score (higher = more fragmented)
+ * Calculate fragmentation metrics for a zone in O(1) from its free block
+ * counters. Returns a fragmentation score (higher = more fragmented)
  */
 float calculate_fragmentation(t_zone *zone);
 /**
- * Defragment memory by consolidating free blocks
+ * Defragment an arena by consolidating free blocks
+ * Unbounded pass over every zone, also empties the defrag queue
  * Returns number of zones defragmented
  */
-int defragment_memory(void);
+int defragment_memory(t_arena *arena);
+
+/**
+ * Queue a zone for deferred coalescing if it is not queued yet
+ */
+void defragment_queue(t_zone *zone);
+
+/**
+ * Take a zone out of its arena's defrag queue before it is unmapped
+ */
+void defragment_forget(t_zone *zone);
+
+/**
+ * Run the queued coalescing passes of an arena for at most budget blocks,
+ * resuming where the previous step stopped
+ */
+void defragment_step(t_arena *arena, size_t budget);
+
+// Purge functions
+/**
+ * Number of whole pages in the data area of a free block, past its links
+ */
+size_t block_purgeable_pages(t_block *block);
+
+/**
+ * Hand the whole pages of the arena's free blocks and empty slabs back to
+ * the kernel, skipping those already purged, stopping after max_pages
+ * Returns the number of pages purged
+ * Caller must hold the arena lock
+ */
+size_t purge_arena(t_arena *arena, size_t max_pages);
+
+/**
+ * Purge the dirty pages of an arena that are older than the decay time,
+ * the pages freed during the last ticks being kept on a linear curve
+ * Caller must hold the arena lock
+ */
+void purge_decay(t_arena *arena, size_t epoch);
+
+// Background purger functions
+/**
+ * Start the background purger if FT_M_BACKGROUND_THREAD asks for it and
+ * it is not running yet
+ * Must be called without holding any arena lock
+ */
+void purger_start(void);
+
+/**
+ * Check whether the background purger owns the deferred work, in which
+ * case malloc() and free() leave it alone
+ */
+t_bool purger_active(void);
+
+/**
+ * Current tick count of the background purger
+ */
+size_t purger_epoch(void);
 
 // Block management functions
+/**
+ * Free-list bin index for a free block size
+ */
+size_t free_bin_index(size_t size);
+
+/**
+ * Link a free block into its zone's bin for its current size
+ */
+void free_bin_insert(t_zone *zone, t_block *block);
+
+/**
+ * Unlink a free block from its zone's bin
+ */
+void free_bin_remove(t_zone *zone, t_block *block);
+
 /**
  * Find a free block in a zone that can accommodate size
+ * Looks in the bin for size, then in the first non-empty larger bin
  */
 t_block *find_free_block(t_zone *zone, size_t size);
 
+/**
+ * Next block of a zone, NULL after the last one
+ */
+t_block *block_next(t_zone *zone, t_block *block);
+
+/**
+ * Previous block of a zone, NULL before the first one
+ */
+t_block *block_prev(t_zone *zone, t_block *block);
+
 /**
  * Split a block if it's too large for the requested size
+ * The remainder is binned as a free block; a free block is re-binned
  */
 t_block *split_block(t_block *block, size_t size);
 
+/**
+ * Cut the front of a binned free block of a SMALL zone off as a free block
+ * of its own, so that the rest starts its data on an alignment boundary.
+ * The block must hold alignment + BLOCK_METADATA_SIZE + MALLOC_ALIGNMENT
+ * bytes more than what the aligned part needs. Returns the binned rest
+ */
+t_block *block_align(t_zone *zone, t_block *block, size_t alignment);
+
+/**
+ * Allocate a binned free block of a zone for needed_size bytes, splitting
+ * the rest off. Returns the BLOCK_PURGED and BLOCK_ZEROED flags the block
+ * had while free
+ */
+size_t block_take(t_zone *zone, t_block *block, size_t needed_size);
+
+/**
+ * Same as block_take() for up to count blocks of needed_size bytes cut out of
+ * one free block back to back, their user pointers stored in ptrs
+ * Returns the number of blocks carved, at least one
+ */
+size_t block_carve(t_zone *zone, t_block *block, size_t needed_size,
+                   size_t count, void **ptrs);
+
+/**
+ * Grow a block over the block following it, which must already be out of
+ * the free-list bins
+ */
+void block_absorb_next(t_zone *zone, t_block *block);
+
 /**
  * Merge adjacent free blocks (coalescing)
+ * Takes a binned free block and returns the merged block, binned
  */
 t_block *merge_blocks(t_block *block);
 
@@ -142,13 +755,22 @@ t_block *merge_blocks(t_block *block);
  */
 t_block *init_block(t_zone *zone, size_t offset, size_t size);
 
+/**
+ * Clear the first size bytes of a block just taken from the free lists,
+ * skipping what state (its BLOCK_PURGED and BLOCK_ZEROED flags while it
+ * was free) tells is zero already
+ */
+void block_zero(t_block *block, size_t size, size_t state);
+
 /**
  * Custom memcpy implementation to copy memory between blocks
+ * Runs the widest of the word, SSE2 and AVX2 kernels the CPU supports
  */
 void *block_memcpy(void *dest, const void *src, size_t n);
 
 /**
- * Custom memset implementation to set memory in a block
+ * Custom memset implementation to set memory in a block, with the same
+ * kernels as block_memcpy()
  */
 void *block_memset(void *s, int c, size_t n);
 
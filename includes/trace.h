@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdint.h>
+
+/*
+ * Layout of the trace files written by debug builds (DEBUG_MALLOC=1) and by
+ * processes started with FT_MALLOC_TRACE set, shared by the library and the
+ * tools
+ */
+
+/* First bytes of a trace file */
+#define TRACE_MAGIC "FTMTRACE"
+/* Bumped whenever t_trace_record changes */
+#define TRACE_VERSION 1
+
+/**
+ * Operation a trace record stands for
+ */
+typedef enum e_trace_op {
+	TRACE_MALLOC,
+	TRACE_CALLOC,
+	TRACE_FREE,
+	TRACE_FREE_SIZED,
+	TRACE_MALLOC_BATCH,
+	TRACE_FREE_BATCH,
+	TRACE_POSIX_MEMALIGN,
+	TRACE_ALIGNED_ALLOC,
+	TRACE_MEMALIGN,
+	TRACE_VALLOC,
+	TRACE_PVALLOC,
+	TRACE_REALLOC,
+	TRACE_OPS
+} t_trace_op;
+
+/**
+ * Start of a trace file, followed by the records
+ */
+typedef struct s_trace_header {
+	char magic[8];        /* TRACE_MAGIC, without its terminator */
+	uint32_t version;     /* TRACE_VERSION */
+	uint32_t record_size; /* sizeof(t_trace_record) */
+} t_trace_header;
+
+/**
+ * One operation, in the order each thread made them; the records of
+ * different threads come in batches, not in time order
+ */
+typedef struct s_trace_record {
+	uint64_t time;     /* CLOCK_MONOTONIC in nanoseconds, taken when an
+	                      allocation returns and when a free is called */
+	uint64_t ptr;      /* Pointer returned or freed, 0 on failure */
+	uint64_t size;     /* Size requested, 0 when not known */
+	uint64_t arg;      /* Alignment of the aligned allocations, pointer
+	                      resized by realloc(), else 0 */
+	uint32_t thread;   /* Kernel thread id */
+	uint16_t op;       /* t_trace_op */
+	uint16_t reserved; /* Always 0 */
+} t_trace_record;
+
+#endif
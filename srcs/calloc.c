@@ -6,8 +6,7 @@ void *calloc(size_t nmemb, size_t size) {
 		return NULL;
 
 	size_t total_size = nmemb * size;
-	void *ptr = malloc(total_size);
-	if (ptr)
-		block_memset(ptr, 0, total_size);
+	void *ptr = alloc_memory(total_size, true);
+	trace_event(TRACE_CALLOC, ptr, total_size, 0);
 	return ptr;
 }
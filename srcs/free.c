@@ -1,44 +1,237 @@
 #include "malloc.h"
 #include "malloc_internal.h"
 
-void free(void *ptr) {
-	if (!ptr) {
-		logger("free", NULL, 0);
+/**
+ * Dirty pages already counted for a free neighbour of a block being freed
+ */
+static size_t counted_dirty_pages(t_block *block) {
+	if (!block || block->magic != MAGIC_NUMBER || !BLOCK_IS_FREE(block) ||
+	    (block->size & BLOCK_PURGED))
+		return 0;
+	return block_purgeable_pages(block);
+}
+
+/**
+ * Count a verified block as free, before it is binned
+ */
+static void block_mark_free(t_zone *zone, t_block *block) {
+	block->size |= BLOCK_FREE;
+	zone->used_blocks--;
+	zone->free_space += BLOCK_SIZE(block) + BLOCK_METADATA_SIZE;
+}
+
+/**
+ * Bin a block marked free, merged with its free neighbours
+ */
+static void block_bin(t_zone *zone, t_block *block) {
+	size_t counted = counted_dirty_pages(block_prev(zone, block)) +
+	                 counted_dirty_pages(block_next(zone, block));
+
+	free_bin_insert(zone, block);
+	block = merge_blocks(block);
+	// Merging joins the pages of the neighbours into whole pages
+	if (zone->type == ZONE_SMALL && !(block->size & BLOCK_PURGED))
+		zone->arena->dirty_pages += block_purgeable_pages(block) - counted;
+}
+
+/**
+ * Unmap, retain or queue for coalescing a zone whose blocks were freed
+ */
+static void zone_settle(t_zone *zone) {
+	if (zone->used_blocks == 0 &&
+	    (zone->type == ZONE_LARGE || !zone_retain(zone)))
+		zone_release(zone);
+	else if (zone->type == ZONE_SMALL &&
+	         calculate_fragmentation(zone) * 100 >
+	           __atomic_load_n(&g_options.frag_threshold, __ATOMIC_RELAXED))
+		defragment_queue(zone);
+}
+
+/**
+ * Run the coalescing and purging work owed by a number of frees
+ */
+static void arena_settle(t_arena *arena, size_t frees) {
+	// The background purger, when running, does the rest
+	if (purger_active())
 		return;
-	}
 
-	pthread_mutex_lock(&g_malloc_mutex);
+	// Coalescing is deferred and paid for in small steps by every free
+	if (arena->defrag_zones)
+		defragment_step(arena, __atomic_load_n(&g_options.coalesce_budget,
+		                                       __ATOMIC_RELAXED) *
+		                         frees);
+	// So is returning free pages to the kernel
+	if (arena->dirty_pages >
+	    __atomic_load_n(&g_options.purge_threshold, __ATOMIC_RELAXED))
+		purge_arena(arena, SIZE_MAX);
+}
+
+void free_block(t_zone *zone, t_block *block) {
+	t_arena *arena = zone->arena;
+
+	block_mark_free(zone, block);
+	block_bin(zone, block);
+	zone_settle(zone);
+	arena_settle(arena, 1);
+}
+
+/**
+ * Hand a block owned by another arena over without taking its lock
+ * Returns FALSE if ptr is not an allocated block of zone
+ */
+static t_bool free_remote(t_zone *zone, void *ptr) {
+	t_bool valid =
+	  (zone->type == ZONE_TINY)
+	    ? slab_owns(zone, ptr) && slab_park(zone, ptr)
+	    : verify_block((t_block *)((char *)ptr - BLOCK_METADATA_SIZE));
+
+	if (valid)
+		remote_free_push(zone, ptr);
+	return valid;
+}
+
+/**
+ * Release a pointer the thread cache did not take to its zone
+ */
+static void free_to_zone(void *ptr) {
 	t_zone *zone = find_zone_containing(ptr);
-	if (!zone) {
-		pthread_mutex_unlock(&g_malloc_mutex);
+	if (!zone)
 		return;
-	}
 
+	t_arena *arena = zone->arena;
 	t_block *block = (t_block *)((char *)ptr - BLOCK_METADATA_SIZE);
-	if (!verify_block(block)) {
-		pthread_mutex_unlock(&g_malloc_mutex);
+	if (arena != get_thread_arena()) {
+		free_remote(zone, ptr);
 		return;
 	}
 
-	t_bool should_defrag =
-	  (zone->type != ZONE_LARGE) ? calculate_fragmentation(zone) > 1.5f : FALSE;
-	block->is_free = true;
-	zone->used_blocks--;
-	zone->free_space += block->size + BLOCK_METADATA_SIZE;
-	block = merge_blocks(block);
-	if (zone->type == ZONE_LARGE && zone->used_blocks == 0) {
-		if (g_zones == zone)
-			g_zones = zone->next;
-		else {
-			t_zone *prev = g_zones;
-			while (prev && prev->next != zone)
-				prev = prev->next;
-			if (prev)
-				prev->next = zone->next;
+	arena_lock(arena);
+	remote_free_drain(arena);
+	if (zone->type == ZONE_TINY) {
+		if (!slab_free(zone, ptr)) {
+			arena_unlock(arena);
+			return;
+		}
+	} else if (verify_block(block)) {
+		free_block(zone, block);
+	} else {
+		arena_unlock(arena);
+		return;
+	}
+	arena_unlock(arena);
+}
+
+void free_memory(void *ptr) {
+	// Started by the first free() once FT_M_BACKGROUND_THREAD is set
+	purger_start();
+
+	// Fast path: park TINY/SMALL blocks in the thread cache without locking
+	if (tcache_put(ptr))
+		return;
+	free_to_zone(ptr);
+}
+
+void free(void *ptr) {
+	// Traced before the block can be handed out again, so that no allocation
+	// returns ptr ahead of this free in the trace
+	trace_event(TRACE_FREE, ptr, 0, 0);
+	if (ptr)
+		free_memory(ptr);
+}
+
+void free_sized(void *ptr, size_t size) {
+	trace_event(TRACE_FREE_SIZED, ptr, size, 0);
+	if (!ptr)
+		return;
+
+	purger_start();
+	// Blocks too large for the thread caches skip the attempt
+	size_t needed_size = ALIGN(size ? size : 1);
+	if (needed_size <= TCACHE_MAX_SIZE && tcache_put_sized(ptr, needed_size))
+		return;
+	free_to_zone(ptr);
+}
+
+void free_aligned_sized(void *ptr, size_t alignment, size_t size) {
+	// TINY requests were rounded up to their alignment by alloc_aligned()
+	if (alignment > MALLOC_ALIGNMENT && alignment <= TINY_MAX_SIZE &&
+	    size <= TINY_MAX_SIZE)
+		size = (size + alignment - 1) & ~(alignment - 1);
+	free_sized(ptr, size);
+}
+
+void free_memory_batch(void **ptrs, size_t count, t_bool cache) {
+	t_bool locked = false;
+	// Zone of the previous blocks, settled once the run of them ends, and
+	// the free block they formed, binned once it stops growing
+	t_zone *run = NULL;
+	t_block *span = NULL;
+	size_t released = 0;
+
+	// The arenas may not exist yet when this is the first call made
+	init_malloc_system();
+	t_arena *arena = get_thread_arena();
+	for (size_t i = 0; i < count; i++) {
+		if (!ptrs[i])
+			continue;
+		// What the thread cache holds is what the next batch takes first
+		if (cache && tcache_put_spare(ptrs[i]))
+			continue;
+		t_zone *zone = find_zone_containing(ptrs[i]);
+		if (!zone)
+			continue;
+		if (zone->arena != arena) {
+			free_remote(zone, ptrs[i]);
+			continue;
+		}
+		if (!locked) {
+			arena_lock(arena);
+			remote_free_drain(arena);
+			locked = true;
 		}
-		munmap(zone, zone->total_size);
-	} else if (should_defrag)
-		defragment_memory();
-	logger("free", ptr, 0);
-	pthread_mutex_unlock(&g_malloc_mutex);
+
+		t_block *block = (t_block *)((char *)ptrs[i] - BLOCK_METADATA_SIZE);
+		if (zone->type != ZONE_TINY && !verify_block(block))
+			continue;
+		if (span && block == block_next(run, span)) {
+			// Blocks freed in address order grow a single free block
+			zone->used_blocks--;
+			zone->free_space += BLOCK_SIZE(block) + BLOCK_METADATA_SIZE;
+			block_absorb_next(zone, span);
+			released++;
+			continue;
+		}
+		if (span)
+			block_bin(run, span);
+		span = NULL;
+		if (run && run != zone)
+			zone_settle(run);
+		run = NULL;
+
+		if (zone->type == ZONE_TINY) {
+			if (!slab_free(zone, ptrs[i]))
+				continue;
+		} else {
+			block_mark_free(zone, block);
+			run = zone;
+			span = block;
+			released++;
+		}
+	}
+	if (!locked)
+		return;
+	if (span) {
+		block_bin(run, span);
+		zone_settle(run);
+	}
+	if (released)
+		arena_settle(arena, released);
+	arena_unlock(arena);
+}
+
+void free_batch(void **ptrs, size_t count) {
+	purger_start();
+	for (size_t i = 0; i < count; i++)
+		trace_event(TRACE_FREE_BATCH, ptrs[i], 0, 0);
+	free_memory_batch(ptrs, count, true);
 }
@@ -0,0 +1,25 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+
+static __thread t_arena *g_thread_arena
+  __attribute__((tls_model("initial-exec"))) = NULL;
+
+t_arena *get_thread_arena(void) {
+	static size_t next_arena = 0;
+
+	if (!g_thread_arena) {
+		size_t index = __atomic_fetch_add(&next_arena, 1, __ATOMIC_RELAXED);
+		g_thread_arena = &g_arenas[index % g_arena_count];
+	}
+	return g_thread_arena;
+}
+
+void arena_lock(t_arena *arena) {
+	if (pthread_mutex_trylock(&arena->mutex) != 0) {
+		pthread_mutex_lock(&arena->mutex);
+		arena->contended++;
+	}
+	arena->lock_count++;
+}
+
+void arena_unlock(t_arena *arena) { pthread_mutex_unlock(&arena->mutex); }
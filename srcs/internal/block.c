@@ -1,72 +1,277 @@
 #include "malloc.h"
 #include "malloc_internal.h"
 
+size_t free_bin_index(size_t size) {
+	if (size < FREE_BINS_EXACT_LIMIT)
+		return size / MALLOC_ALIGNMENT;
+
+	// Four bins per power of two above the exact range
+	size_t msb = 63 - __builtin_clzl(size);
+	size_t index = FREE_BINS_EXACT_LIMIT / MALLOC_ALIGNMENT +
+	               (msb - __builtin_ctzl(FREE_BINS_EXACT_LIMIT)) * 4 +
+	               ((size >> (msb - 2)) & 3);
+	return index < FREE_BINS ? index : FREE_BINS - 1;
+}
+
+/**
+ * Size of the largest free block, looked up in the highest non-empty bin
+ */
+static size_t free_bin_largest(t_zone *zone) {
+	if (!zone->free_map)
+		return 0;
+
+	size_t index = 63 - __builtin_clzl(zone->free_map);
+	if (index < FREE_BINS_EXACT_LIMIT / MALLOC_ALIGNMENT)
+		return index * MALLOC_ALIGNMENT;
+
+	size_t largest = 0;
+	for (t_block *block = zone->free_bins[index]; block;
+	     block = FREE_LINKS(block)->next)
+		if (BLOCK_SIZE(block) > largest)
+			largest = BLOCK_SIZE(block);
+	return largest;
+}
+
+void free_bin_insert(t_zone *zone, t_block *block) {
+	size_t index = free_bin_index(BLOCK_SIZE(block));
+	t_free_links *links = FREE_LINKS(block);
+
+	t_zone_stats *stats = ZONE_STATS(zone);
+	stats->fragmented -= zone->total_free - zone->largest_free;
+	zone->free_count++;
+	zone->total_free += BLOCK_SIZE(block);
+	if (BLOCK_SIZE(block) > zone->largest_free)
+		zone->largest_free = BLOCK_SIZE(block);
+	stats->fragmented += zone->total_free - zone->largest_free;
+	stats->free += BLOCK_SIZE(block);
+	stats->free_blocks++;
+
+	links->prev = NULL;
+	links->next = zone->free_bins[index];
+	if (links->next)
+		FREE_LINKS(links->next)->prev = block;
+	zone->free_bins[index] = block;
+	zone->free_map |= 1UL << index;
+	zone_index_update(zone);
+}
+
+void free_bin_remove(t_zone *zone, t_block *block) {
+	size_t index = free_bin_index(BLOCK_SIZE(block));
+	t_free_links *links = FREE_LINKS(block);
+
+	if (links->prev)
+		FREE_LINKS(links->prev)->next = links->next;
+	else
+		zone->free_bins[index] = links->next;
+	if (links->next)
+		FREE_LINKS(links->next)->prev = links->prev;
+	if (!zone->free_bins[index]) {
+		zone->free_map &= ~(1UL << index);
+		zone_index_update(zone);
+	}
+
+	t_zone_stats *stats = ZONE_STATS(zone);
+	stats->fragmented -= zone->total_free - zone->largest_free;
+	zone->free_count--;
+	zone->total_free -= BLOCK_SIZE(block);
+	if (BLOCK_SIZE(block) == zone->largest_free)
+		zone->largest_free = free_bin_largest(zone);
+	stats->fragmented += zone->total_free - zone->largest_free;
+	stats->free -= BLOCK_SIZE(block);
+	stats->free_blocks--;
+}
+
 t_block *find_free_block(t_zone *zone, size_t size) {
-	t_block *block = zone->blocks;
+	size_t index = free_bin_index(size);
 
-	// First-fit approach
-	while (block) {
-		if (block->is_free && block->size >= size)
+	// First-fit inside the bin of the requested size (exact below the limit)
+	for (t_block *block = zone->free_bins[index]; block;
+	     block = FREE_LINKS(block)->next)
+		if (BLOCK_SIZE(block) >= size)
 			return block;
-		block = block->next;
-	}
 
-	return NULL;
+	// Any block of a larger non-empty bin fits
+	uint64_t larger = zone->free_map & ~((2UL << index) - 1);
+	if (!larger)
+		return NULL;
+	return zone->free_bins[__builtin_ctzl(larger)];
+}
+
+t_block *block_next(t_zone *zone, t_block *block) {
+	char *next = (char *)BLOCK_DATA(block) + BLOCK_SIZE(block);
+
+	if (next >= (char *)zone->start + zone->total_size)
+		return NULL;
+	return (t_block *)next;
+}
+
+t_block *block_prev(t_zone *zone, t_block *block) {
+	if (!block->prev)
+		return NULL;
+	return (t_block *)((char *)zone->start + block->prev);
+}
+
+/**
+ * Point the block following block back at it
+ */
+static void block_relink_next(t_zone *zone, t_block *block) {
+	t_block *next = block_next(zone, block);
+
+	if (next)
+		next->prev = (uint32_t)((char *)block - (char *)zone->start);
 }
 
 t_block *split_block(t_block *block, size_t size) {
 	// Check if block can be split
 	size_t required_size = ALIGN(size);
-	size_t remaining = block->size - required_size;
+	size_t remaining = BLOCK_SIZE(block) - required_size;
 
 	// Not enough space to create a useful new block
 	if (remaining < BLOCK_METADATA_SIZE + MALLOC_ALIGNMENT)
 		return block;
 
+	// A LARGE zone keeps a single block, registered by its first page only
+	t_zone *zone = BLOCK_ZONE(block);
+	if (zone->type == ZONE_LARGE)
+		return block;
+
+	size_t offset = (char *)block - (char *)zone->start;
+	// Links are 32-bit zone offsets
+	if (offset + BLOCK_METADATA_SIZE + required_size > UINT32_MAX)
+		return block;
+
+	t_bool was_free = BLOCK_IS_FREE(block);
+	if (was_free)
+		free_bin_remove(zone, block);
+
 	// Create new block after the current one
 	t_block *new_block =
-	  (t_block *)((char *)block + BLOCK_METADATA_SIZE + required_size);
-	new_block->size = remaining - BLOCK_METADATA_SIZE;
-	new_block->is_free = true;
+	  (t_block *)((char *)BLOCK_DATA(block) + required_size);
+	new_block->size = (remaining - BLOCK_METADATA_SIZE) | BLOCK_FREE |
+	                  (block->size & (BLOCK_PURGED | BLOCK_ZEROED));
 	new_block->magic = MAGIC_NUMBER;
-	new_block->offset = block->offset + BLOCK_METADATA_SIZE + required_size;
-
-	// Link the new block
-	new_block->next = block->next;
-	if (new_block->next)
-		new_block->next->prev = new_block;
-	new_block->prev = block;
-	block->next = new_block;
+	new_block->prev = (uint32_t)offset;
+	ZONE_STATS(zone)->metadata += BLOCK_METADATA_SIZE;
 
 	// Update original block
-	block->size = required_size;
+	block->size = required_size | (block->size & BLOCK_FLAGS);
+	block_relink_next(zone, new_block);
+	if (was_free)
+		free_bin_insert(zone, block);
+	free_bin_insert(zone, new_block);
+	// A shrunk used block may leave the remainder next to a free block
+	if (!was_free)
+		merge_blocks(new_block);
 
 	return block;
 }
 
+t_block *block_align(t_zone *zone, t_block *block, size_t alignment) {
+	uintptr_t data = (uintptr_t)BLOCK_DATA(block);
+	uintptr_t aligned = (data + alignment - 1) & ~(alignment - 1);
+
+	if (aligned == data)
+		return block;
+	// The front must be large enough to become a block of its own
+	while (aligned - data < BLOCK_METADATA_SIZE + MALLOC_ALIGNMENT)
+		aligned += alignment;
+
+	size_t front = aligned - data - BLOCK_METADATA_SIZE;
+	free_bin_remove(zone, block);
+	t_block *rest = (t_block *)(aligned - BLOCK_METADATA_SIZE);
+	rest->size = (BLOCK_SIZE(block) - front - BLOCK_METADATA_SIZE) |
+	             (block->size & BLOCK_FLAGS);
+	rest->magic = MAGIC_NUMBER;
+	rest->prev = (uint32_t)((char *)block - (char *)zone->start);
+	block->size = front | (block->size & BLOCK_FLAGS);
+	block_relink_next(zone, rest);
+	ZONE_STATS(zone)->metadata += BLOCK_METADATA_SIZE;
+	free_bin_insert(zone, block);
+	free_bin_insert(zone, rest);
+	return rest;
+}
+
+size_t block_take(t_zone *zone, t_block *block, size_t needed_size) {
+	free_bin_remove(zone, block);
+	block->size &= ~(size_t)BLOCK_FREE;
+	// The remainder of a purged or untouched block keeps its state
+	size_t state = block->size & (BLOCK_PURGED | BLOCK_ZEROED);
+	block = split_block(block, needed_size);
+	block->size &= ~(size_t)(BLOCK_PURGED | BLOCK_ZEROED);
+	if (!zone->used_blocks)
+		zone_reuse(zone);
+	zone->used_blocks++;
+	zone->free_space -= BLOCK_METADATA_SIZE + BLOCK_SIZE(block);
+	return state;
+}
+
+size_t block_carve(t_zone *zone, t_block *block, size_t needed_size,
+                   size_t count, void **ptrs) {
+	size_t stride = BLOCK_METADATA_SIZE + needed_size;
+	size_t fits = (BLOCK_SIZE(block) + BLOCK_METADATA_SIZE) / stride;
+
+	if (zone->type == ZONE_LARGE || !fits)
+		fits = 1;
+	if (count > fits)
+		count = fits;
+	// One bin removal and one split for the whole run
+	block_take(zone, block, count * stride - BLOCK_METADATA_SIZE);
+	for (size_t i = 1; i < count; i++) {
+		t_block *next = (t_block *)((char *)BLOCK_DATA(block) + needed_size);
+
+		// The last block keeps whatever the split left over
+		next->size = BLOCK_SIZE(block) - stride;
+		next->prev = (uint32_t)((char *)block - (char *)zone->start);
+		next->magic = MAGIC_NUMBER;
+		block->size = needed_size;
+		*ptrs++ = BLOCK_DATA(block);
+		block = next;
+	}
+	block_relink_next(zone, block);
+	*ptrs = BLOCK_DATA(block);
+	zone->used_blocks += count - 1;
+	ZONE_STATS(zone)->metadata += (count - 1) * BLOCK_METADATA_SIZE;
+	return count;
+}
+
+void block_absorb_next(t_zone *zone, t_block *block) {
+	t_block *next = block_next(zone, block);
+
+	block->size += BLOCK_METADATA_SIZE + BLOCK_SIZE(next);
+	ZONE_STATS(zone)->metadata -= BLOCK_METADATA_SIZE;
+	// The pages around the vanished header were neither purged nor zero
+	block->size &= ~(size_t)(BLOCK_PURGED | BLOCK_ZEROED);
+	// A later free() of the absorbed block must not find a valid header
+	next->magic = 0;
+	block_relink_next(zone, block);
+	// Keep an interrupted coalescing pass off the vanished header
+	if (zone->defrag_cursor == (size_t)((char *)next - (char *)zone->start))
+		zone->defrag_cursor = (char *)block - (char *)zone->start;
+}
+
 t_block *merge_blocks(t_block *block) {
-	if (!block || !block->is_free)
+	if (!block || !BLOCK_IS_FREE(block))
 		return block;
 
+	t_zone *zone = BLOCK_ZONE(block);
+	free_bin_remove(zone, block);
+
 	// Merge with next block if it's free
-	if (block->next && block->next->magic == MAGIC_NUMBER &&
-	    block->next->is_free) {
-		block->size += BLOCK_METADATA_SIZE + block->next->size;
-		block->next = block->next->next;
-		if (block->next)
-			block->next->prev = block;
+	t_block *next = block_next(zone, block);
+	if (next && next->magic == MAGIC_NUMBER && BLOCK_IS_FREE(next)) {
+		free_bin_remove(zone, next);
+		block_absorb_next(zone, block);
 	}
 
 	// Merge with previous block if it's free
-	if (block->prev && block->prev->magic == MAGIC_NUMBER &&
-	    block->prev->is_free) {
-		block->prev->size += BLOCK_METADATA_SIZE + block->size;
-		block->prev->next = block->next;
-		if (block->next)
-			block->next->prev = block->prev;
-		block = block->prev;
+	t_block *prev = block_prev(zone, block);
+	if (prev && prev->magic == MAGIC_NUMBER && BLOCK_IS_FREE(prev)) {
+		free_bin_remove(zone, prev);
+		block_absorb_next(zone, prev);
+		block = prev;
 	}
 
+	free_bin_insert(zone, block);
 	return block;
 }
 
@@ -74,11 +279,8 @@ t_block *init_block(t_zone *zone, size_t offset, size_t size) {
 	t_block *block = (t_block *)((char *)zone->start + offset);
 
 	block->size = size;
-	block->is_free = false;
 	block->magic = MAGIC_NUMBER;
-	block->offset = offset;
-	block->next = NULL;
-	block->prev = NULL;
+	block->prev = 0;
 
 	// Update zone metadata
 	zone->used_blocks++;
@@ -87,23 +289,32 @@ t_block *init_block(t_zone *zone, size_t offset, size_t size) {
 	return block;
 }
 
-void *block_memcpy(void *dest, const void *src, size_t n) {
-	char *d = (char *)dest;
-	const char *s = (const char *)src;
-
-	if (!dest || !src)
-		return dest;
-	for (size_t i = 0; i < n; i++)
-		d[i] = s[i];
-	return dest;
-}
+void block_zero(t_block *block, size_t size, size_t state) {
+	char *data = BLOCK_DATA(block);
+	char *end = data + size;
 
-void *block_memset(void *s, int c, size_t n) {
-	unsigned char *p = (unsigned char *)s;
+	// Untouched since it was mapped: only the free-list links were written
+	if ((state & BLOCK_ZEROED) && !(state & BLOCK_PURGED)) {
+		block_memset(data, 0, size < sizeof(t_free_links) ? size
+		                                                  : sizeof(t_free_links));
+		return;
+	}
 
-	if (!s)
-		return s;
-	for (size_t i = 0; i < n; i++)
-		p[i] = (unsigned char)c;
-	return s;
+	// Whole pages to skip: purged with MADV_DONTNEED, or dropped right now
+	char *first = (char *)PAGE_ALIGN((uintptr_t)data + sizeof(t_free_links));
+	char *last = (char *)PAGE_FLOOR(data + BLOCK_SIZE(block));
+	if (!(state & BLOCK_ZEROED)) {
+		first = (char *)PAGE_ALIGN((uintptr_t)data);
+		last = (char *)PAGE_FLOOR(end);
+		if (size < CALLOC_DONTNEED_MIN ||
+		    madvise(first, last - first, MADV_DONTNEED) != 0)
+			first = last = end;
+	}
+	if (first >= end || last <= first) {
+		block_memset(data, 0, size);
+		return;
+	}
+	block_memset(data, 0, first - data);
+	if (last < end)
+		block_memset(last, 0, end - last);
 }
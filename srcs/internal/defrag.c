@@ -2,65 +2,108 @@
 #include "malloc_internal.h"
 
 float calculate_fragmentation(t_zone *zone) {
-	if (!zone || !zone->blocks)
+	if (!zone)
 		return 0.0f;
 
-	size_t total_free = 0;
-	size_t largest_free = 0;
-	size_t free_count = 0;
-	size_t block_count = 0;
-
-	t_block *block = zone->blocks;
-	while (block) {
-		block_count++;
-		if (block->is_free) {
-			free_count++;
-			total_free += block->size;
-			if (block->size > largest_free)
-				largest_free = block->size;
-		}
-		block = block->next;
-	}
-
 	// No free blocks or only one - no fragmentation
-	if (free_count <= 1 || total_free == 0)
+	if (zone->free_count <= 1 || zone->total_free == 0)
 		return 0.0f;
 
 	// Calculate fragmentation ratio:
 	// 1.0 = unfragmented (one large free block)
 	// Higher values = more fragmented
-	return (float)free_count * total_free / (largest_free * largest_free);
+	return (float)zone->free_count * zone->total_free /
+	       ((float)zone->largest_free * zone->largest_free);
+}
+
+/**
+ * Visit the blocks of a zone from block on, merging adjacent free blocks
+ * Stops after budget blocks; returns the block to resume from, or NULL
+ * once the end of the zone is reached
+ */
+static t_block *defragment_zone(t_zone *zone, t_block *block, size_t *budget,
+                                t_bool *coalesced) {
+	while (block && *budget) {
+		t_block *next_block = block_next(zone, block);
+		// Merge adjacent free blocks
+		if (BLOCK_IS_FREE(block) && next_block && BLOCK_IS_FREE(next_block)) {
+			block = merge_blocks(block);
+			*coalesced = true;
+		}
+		block = block_next(zone, block);
+		--*budget;
+	}
+	return block;
 }
 
 /**
- * Defragment memory by consolidating free blocks
- * Returns number of zones defragmented
+ * Take the head zone out of an arena's defrag queue
  */
-int defragment_memory(void) {
+static void defragment_dequeue(t_arena *arena) {
+	t_zone *zone = arena->defrag_zones;
+
+	arena->defrag_zones = zone->defrag_next;
+	zone->defrag_next = NULL;
+	zone->defrag_queued = false;
+	zone->defrag_cursor = 0;
+}
+
+void defragment_forget(t_zone *zone) {
+	t_zone **link = &zone->arena->defrag_zones;
+
+	while (*link != zone)
+		link = &(*link)->defrag_next;
+	*link = zone->defrag_next;
+	zone->defrag_next = NULL;
+	zone->defrag_queued = false;
+	zone->defrag_cursor = 0;
+}
+
+void defragment_queue(t_zone *zone) {
+	if (zone->defrag_queued)
+		return;
+	zone->defrag_queued = true;
+	zone->defrag_cursor = 0;
+	zone->defrag_next = zone->arena->defrag_zones;
+	zone->arena->defrag_zones = zone;
+}
+
+void defragment_step(t_arena *arena, size_t budget) {
+	t_bool coalesced = false;
+
+	while (budget && arena->defrag_zones) {
+		t_zone *zone = arena->defrag_zones;
+		t_block *block = zone->blocks;
+
+		if (zone->defrag_cursor)
+			block = (t_block *)((char *)zone->start + zone->defrag_cursor);
+		block = defragment_zone(zone, block, &budget, &coalesced);
+		if (block) {
+			// Out of budget: the next step resumes here
+			zone->defrag_cursor = (char *)block - (char *)zone->start;
+			return;
+		}
+		defragment_dequeue(arena);
+	}
+}
+
+int defragment_memory(t_arena *arena) {
 	int zones_defragged = 0;
-	t_zone *zone = g_zones;
+	t_zone *zone = arena->zones;
 
 	while (zone) {
 		t_zone *next_zone = zone->next;
-		t_block *block = zone->blocks;
-
+		size_t budget = SIZE_MAX;
 		t_bool coalesced = false;
-		while (block) {
-			t_block *next_block = block->next;
-			// Merge adjacent free blocks
-			if (block->is_free && next_block && next_block->is_free) {
-				block->size += BLOCK_METADATA_SIZE + next_block->size;
-				block->next = next_block->next;
-				if (next_block->next)
-					next_block->next->prev = block;
-				coalesced = true;
-			}
-			block = block->next;
-		}
+
+		defragment_zone(zone, zone->blocks, &budget, &coalesced);
 		if (coalesced)
 			zones_defragged++;
 		zone = next_zone;
 	}
 
+	// Every queued pass is complete now
+	while (arena->defrag_zones)
+		defragment_dequeue(arena);
 	return zones_defragged;
 }
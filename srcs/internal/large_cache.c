@@ -0,0 +1,172 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+#include <time.h>
+
+/*
+ * Freed LARGE mappings shared by every arena. Regions are bucketed by size
+ * for lookups and kept in free order so that the oldest decays first.
+ */
+static pthread_mutex_t g_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static t_cached_region *g_buckets[LARGE_CACHE_BUCKETS];
+static t_cached_region *g_newest;
+static t_cached_region *g_oldest;
+static t_large_cache_stats g_stats;
+
+static size_t now_ms(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * Bucket of a mapping length: one per page below 16 pages, then four per
+ * power of two
+ */
+static size_t large_cache_index(size_t size) {
+	size_t pages = size >> PAGEMAP_SHIFT;
+
+	if (pages < 16)
+		return pages;
+
+	size_t msb = 63 - __builtin_clzl(pages);
+	size_t index = 16 + (msb - 4) * 4 + ((pages >> (msb - 2)) & 3);
+	return index < LARGE_CACHE_BUCKETS ? index : LARGE_CACHE_BUCKETS - 1;
+}
+
+static void large_cache_unlink(t_cached_region *region) {
+	size_t index = large_cache_index(region->size);
+
+	if (region->prev)
+		region->prev->next = region->next;
+	else
+		g_buckets[index] = region->next;
+	if (region->next)
+		region->next->prev = region->prev;
+	if (region->older)
+		region->older->newer = region->newer;
+	else
+		g_oldest = region->newer;
+	if (region->newer)
+		region->newer->older = region->older;
+	else
+		g_newest = region->older;
+	g_stats.regions--;
+	g_stats.bytes -= region->size;
+}
+
+/**
+ * Move the oldest region to the evicted list, to be unmapped once the lock
+ * is released
+ */
+static void large_cache_evict_oldest(t_cached_region **evicted) {
+	t_cached_region *region = g_oldest;
+
+	large_cache_unlink(region);
+	region->next = *evicted;
+	*evicted = region;
+	g_stats.evictions++;
+}
+
+static void large_cache_unmap(t_cached_region *evicted) {
+	while (evicted) {
+		t_cached_region *next = evicted->next;
+		munmap(evicted, evicted->size);
+		evicted = next;
+	}
+}
+
+/**
+ * Evict the regions whose decay delay has elapsed
+ * Caller must hold the cache lock
+ */
+static void large_cache_expire(t_cached_region **evicted) {
+	size_t decay =
+	  __atomic_load_n(&g_options.large_cache_decay, __ATOMIC_RELAXED);
+	size_t now = now_ms();
+
+	while (g_oldest && g_oldest->freed_at + decay <= now)
+		large_cache_evict_oldest(evicted);
+}
+
+void *large_cache_get(size_t *size) {
+	t_cached_region *evicted = NULL, *found = NULL;
+	size_t index = large_cache_index(*size);
+
+	pthread_mutex_lock(&g_cache_mutex);
+	large_cache_expire(&evicted);
+	// First fit in the request's bucket, wasting at most half the region
+	for (t_cached_region *region = g_buckets[index]; region;
+	     region = region->next) {
+		if (region->size >= *size && region->size / 2 <= *size) {
+			found = region;
+			break;
+		}
+	}
+	// Any region of the next bucket is larger, but not by much
+	if (!found && index + 1 < LARGE_CACHE_BUCKETS && g_buckets[index + 1] &&
+	    g_buckets[index + 1]->size / 2 <= *size)
+		found = g_buckets[index + 1];
+	if (found) {
+		large_cache_unlink(found);
+		*size = found->size;
+		g_stats.hits++;
+	} else
+		g_stats.misses++;
+	pthread_mutex_unlock(&g_cache_mutex);
+
+	large_cache_unmap(evicted);
+	return found;
+}
+
+void large_cache_put(void *start, size_t size) {
+	t_cached_region *evicted = NULL, *region = start;
+	size_t max = __atomic_load_n(&g_options.large_cache_max, __ATOMIC_RELAXED);
+
+	if (size > max) {
+		munmap(start, size);
+		return;
+	}
+
+	pthread_mutex_lock(&g_cache_mutex);
+	large_cache_expire(&evicted);
+	// Make room under the byte cap, oldest regions first
+	while (g_oldest && g_stats.bytes + size > max)
+		large_cache_evict_oldest(&evicted);
+
+	size_t index = large_cache_index(size);
+	region->size = size;
+	region->freed_at = now_ms();
+	region->prev = NULL;
+	region->next = g_buckets[index];
+	if (region->next)
+		region->next->prev = region;
+	g_buckets[index] = region;
+	region->newer = NULL;
+	region->older = g_newest;
+	if (g_newest)
+		g_newest->newer = region;
+	else
+		g_oldest = region;
+	g_newest = region;
+	g_stats.regions++;
+	g_stats.bytes += size;
+	pthread_mutex_unlock(&g_cache_mutex);
+
+	large_cache_unmap(evicted);
+}
+
+void large_cache_decay(void) {
+	t_cached_region *evicted = NULL;
+
+	pthread_mutex_lock(&g_cache_mutex);
+	large_cache_expire(&evicted);
+	pthread_mutex_unlock(&g_cache_mutex);
+	large_cache_unmap(evicted);
+}
+
+void large_cache_get_stats(t_large_cache_stats *stats) {
+	pthread_mutex_lock(&g_cache_mutex);
+	*stats = g_stats;
+	pthread_mutex_unlock(&g_cache_mutex);
+}
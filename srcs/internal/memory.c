@@ -0,0 +1,305 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/* Unaligned accesses that may alias anything */
+typedef uint64_t t_word __attribute__((may_alias, aligned(1)));
+typedef uint32_t t_half __attribute__((may_alias, aligned(1)));
+
+typedef void (*t_copy_kernel)(char *, const char *, size_t);
+typedef void (*t_set_kernel)(char *, unsigned char, size_t);
+
+static void copy_resolve(char *d, const char *s, size_t n);
+static void set_resolve(char *d, unsigned char c, size_t n);
+
+/* Kernels picked on the first call, from what the CPU supports */
+static t_copy_kernel g_copy_kernel = copy_resolve;
+static t_set_kernel g_set_kernel = set_resolve;
+/* Sizes from which stores bypass the caches */
+static size_t g_nt_threshold = BLOCK_NT_THRESHOLD;
+
+/**
+ * Copy fewer than 16 bytes with two overlapping accesses at most
+ */
+static void copy_small(char *d, const char *s, size_t n) {
+	if (n >= 8) {
+		t_word head = *(const t_word *)s;
+		t_word tail = *(const t_word *)(s + n - 8);
+		*(t_word *)d = head;
+		*(t_word *)(d + n - 8) = tail;
+	} else if (n >= 4) {
+		t_half head = *(const t_half *)s;
+		t_half tail = *(const t_half *)(s + n - 4);
+		*(t_half *)d = head;
+		*(t_half *)(d + n - 4) = tail;
+	} else {
+		for (size_t i = 0; i < n; i++)
+			d[i] = s[i];
+	}
+}
+
+static void set_small(char *d, uint64_t pattern, size_t n) {
+	if (n >= 8) {
+		*(t_word *)d = pattern;
+		*(t_word *)(d + n - 8) = pattern;
+	} else if (n >= 4) {
+		*(t_half *)d = (uint32_t)pattern;
+		*(t_half *)(d + n - 4) = (uint32_t)pattern;
+	} else {
+		for (size_t i = 0; i < n; i++)
+			d[i] = (char)pattern;
+	}
+}
+
+/*
+ * Every kernel below writes an unaligned head, then aligned chunks from the
+ * first aligned destination address, then an unaligned tail ending exactly
+ * at d + n. Head and tail overlap the chunks instead of being done bytewise
+ */
+
+#if !defined(__x86_64__)
+
+/* Portable kernels, x86-64 always has SSE2 */
+static void copy_words(char *d, const char *s, size_t n) {
+	if (n < 16) {
+		copy_small(d, s, n);
+		return;
+	}
+	t_word tail = *(const t_word *)(s + n - 8);
+	*(t_word *)d = *(const t_word *)s;
+	size_t skip = 8 - ((uintptr_t)d & 7);
+	char *end = d + n;
+	for (d += skip, s += skip; d + 8 <= end; d += 8, s += 8)
+		*(uint64_t *)d = *(const t_word *)s;
+	*(t_word *)(end - 8) = tail;
+}
+
+static void set_words(char *d, unsigned char c, size_t n) {
+	uint64_t pattern = c * 0x0101010101010101ULL;
+
+	if (n < 16) {
+		set_small(d, pattern, n);
+		return;
+	}
+	*(t_word *)d = pattern;
+	char *end = d + n;
+	for (d += 8 - ((uintptr_t)d & 7); d + 8 <= end; d += 8)
+		*(uint64_t *)d = pattern;
+	*(t_word *)(end - 8) = pattern;
+}
+
+#else
+
+static void copy_sse2(char *d, const char *s, size_t n) {
+	if (n < 32) {
+		if (n < 16) {
+			copy_small(d, s, n);
+			return;
+		}
+		__m128i head = _mm_loadu_si128((const __m128i *)s);
+		__m128i tail = _mm_loadu_si128((const __m128i *)(s + n - 16));
+		_mm_storeu_si128((__m128i *)d, head);
+		_mm_storeu_si128((__m128i *)(d + n - 16), tail);
+		return;
+	}
+
+	__m128i tail = _mm_loadu_si128((const __m128i *)(s + n - 16));
+	t_bool stream = n >= g_nt_threshold;
+	_mm_storeu_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+	size_t skip = 16 - ((uintptr_t)d & 15);
+	char *end = d + n;
+	for (d += skip, s += skip; d + 64 <= end; d += 64, s += 64) {
+		__m128i a = _mm_loadu_si128((const __m128i *)s);
+		__m128i b = _mm_loadu_si128((const __m128i *)(s + 16));
+		__m128i c = _mm_loadu_si128((const __m128i *)(s + 32));
+		__m128i e = _mm_loadu_si128((const __m128i *)(s + 48));
+		if (stream) {
+			_mm_stream_si128((__m128i *)d, a);
+			_mm_stream_si128((__m128i *)(d + 16), b);
+			_mm_stream_si128((__m128i *)(d + 32), c);
+			_mm_stream_si128((__m128i *)(d + 48), e);
+		} else {
+			_mm_store_si128((__m128i *)d, a);
+			_mm_store_si128((__m128i *)(d + 16), b);
+			_mm_store_si128((__m128i *)(d + 32), c);
+			_mm_store_si128((__m128i *)(d + 48), e);
+		}
+	}
+	if (stream)
+		_mm_sfence();
+	for (; d + 16 <= end; d += 16, s += 16)
+		_mm_store_si128((__m128i *)d, _mm_loadu_si128((const __m128i *)s));
+	_mm_storeu_si128((__m128i *)(end - 16), tail);
+}
+
+static void set_sse2(char *d, unsigned char c, size_t n) {
+	if (n < 16) {
+		set_small(d, c * 0x0101010101010101ULL, n);
+		return;
+	}
+
+	__m128i pattern = _mm_set1_epi8((char)c);
+	t_bool stream = n >= g_nt_threshold;
+	_mm_storeu_si128((__m128i *)d, pattern);
+	char *end = d + n;
+	for (d += 16 - ((uintptr_t)d & 15); d + 64 <= end; d += 64) {
+		if (stream) {
+			_mm_stream_si128((__m128i *)d, pattern);
+			_mm_stream_si128((__m128i *)(d + 16), pattern);
+			_mm_stream_si128((__m128i *)(d + 32), pattern);
+			_mm_stream_si128((__m128i *)(d + 48), pattern);
+		} else {
+			_mm_store_si128((__m128i *)d, pattern);
+			_mm_store_si128((__m128i *)(d + 16), pattern);
+			_mm_store_si128((__m128i *)(d + 32), pattern);
+			_mm_store_si128((__m128i *)(d + 48), pattern);
+		}
+	}
+	if (stream)
+		_mm_sfence();
+	for (; d + 16 <= end; d += 16)
+		_mm_store_si128((__m128i *)d, pattern);
+	_mm_storeu_si128((__m128i *)(end - 16), pattern);
+}
+
+__attribute__((target("avx2"))) static void copy_avx2(char *d, const char *s,
+                                                      size_t n) {
+	if (n < 64) {
+		copy_sse2(d, s, n);
+		return;
+	}
+
+	__m256i tail = _mm256_loadu_si256((const __m256i *)(s + n - 32));
+	t_bool stream = n >= g_nt_threshold;
+	_mm256_storeu_si256((__m256i *)d, _mm256_loadu_si256((const __m256i *)s));
+	size_t skip = 32 - ((uintptr_t)d & 31);
+	char *end = d + n;
+	for (d += skip, s += skip; d + 128 <= end; d += 128, s += 128) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)s);
+		__m256i b = _mm256_loadu_si256((const __m256i *)(s + 32));
+		__m256i c = _mm256_loadu_si256((const __m256i *)(s + 64));
+		__m256i e = _mm256_loadu_si256((const __m256i *)(s + 96));
+		if (stream) {
+			_mm256_stream_si256((__m256i *)d, a);
+			_mm256_stream_si256((__m256i *)(d + 32), b);
+			_mm256_stream_si256((__m256i *)(d + 64), c);
+			_mm256_stream_si256((__m256i *)(d + 96), e);
+		} else {
+			_mm256_store_si256((__m256i *)d, a);
+			_mm256_store_si256((__m256i *)(d + 32), b);
+			_mm256_store_si256((__m256i *)(d + 64), c);
+			_mm256_store_si256((__m256i *)(d + 96), e);
+		}
+	}
+	if (stream)
+		_mm_sfence();
+	for (; d + 32 <= end; d += 32, s += 32)
+		_mm256_store_si256((__m256i *)d,
+		                   _mm256_loadu_si256((const __m256i *)s));
+	_mm256_storeu_si256((__m256i *)(end - 32), tail);
+	_mm256_zeroupper();
+}
+
+__attribute__((target("avx2"))) static void set_avx2(char *d, unsigned char c,
+                                                     size_t n) {
+	if (n < 64) {
+		set_sse2(d, c, n);
+		return;
+	}
+
+	__m256i pattern = _mm256_set1_epi8((char)c);
+	t_bool stream = n >= g_nt_threshold;
+	_mm256_storeu_si256((__m256i *)d, pattern);
+	char *end = d + n;
+	for (d += 32 - ((uintptr_t)d & 31); d + 128 <= end; d += 128) {
+		if (stream) {
+			_mm256_stream_si256((__m256i *)d, pattern);
+			_mm256_stream_si256((__m256i *)(d + 32), pattern);
+			_mm256_stream_si256((__m256i *)(d + 64), pattern);
+			_mm256_stream_si256((__m256i *)(d + 96), pattern);
+		} else {
+			_mm256_store_si256((__m256i *)d, pattern);
+			_mm256_store_si256((__m256i *)(d + 32), pattern);
+			_mm256_store_si256((__m256i *)(d + 64), pattern);
+			_mm256_store_si256((__m256i *)(d + 96), pattern);
+		}
+	}
+	if (stream)
+		_mm_sfence();
+	for (; d + 32 <= end; d += 32)
+		_mm256_store_si256((__m256i *)d, pattern);
+	_mm256_storeu_si256((__m256i *)(end - 32), pattern);
+	_mm256_zeroupper();
+}
+
+/**
+ * Check through cpuid that the CPU has AVX2 and that the kernel saves the
+ * YMM registers on context switches
+ */
+static t_bool cpu_has_avx2(void) {
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_OSXSAVE) ||
+	    !(ecx & bit_AVX))
+		return false;
+	unsigned int xcr0_low, xcr0_high;
+	__asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+	if ((xcr0_low & 0x6) != 0x6)
+		return false;
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return false;
+	return (ebx & bit_AVX2) != 0;
+}
+
+#endif
+
+/**
+ * Pick the widest kernels the CPU runs. Racing threads pick the same ones
+ */
+static void kernels_resolve(void) {
+	long cache = sysconf(_SC_LEVEL3_CACHE_SIZE);
+
+	// Streaming pays off once the buffer would evict most of the cache
+	if (cache > 0)
+		g_nt_threshold = (size_t)cache / 4 * 3;
+#if defined(__x86_64__)
+	if (cpu_has_avx2()) {
+		__atomic_store_n(&g_copy_kernel, copy_avx2, __ATOMIC_RELAXED);
+		__atomic_store_n(&g_set_kernel, set_avx2, __ATOMIC_RELAXED);
+	} else {
+		__atomic_store_n(&g_copy_kernel, copy_sse2, __ATOMIC_RELAXED);
+		__atomic_store_n(&g_set_kernel, set_sse2, __ATOMIC_RELAXED);
+	}
+#else
+	__atomic_store_n(&g_copy_kernel, copy_words, __ATOMIC_RELAXED);
+	__atomic_store_n(&g_set_kernel, set_words, __ATOMIC_RELAXED);
+#endif
+}
+
+static void copy_resolve(char *d, const char *s, size_t n) {
+	kernels_resolve();
+	g_copy_kernel(d, s, n);
+}
+
+static void set_resolve(char *d, unsigned char c, size_t n) {
+	kernels_resolve();
+	g_set_kernel(d, c, n);
+}
+
+void *block_memcpy(void *dest, const void *src, size_t n) {
+	if (!dest || !src)
+		return dest;
+	__atomic_load_n(&g_copy_kernel, __ATOMIC_RELAXED)(dest, src, n);
+	return dest;
+}
+
+void *block_memset(void *s, int c, size_t n) {
+	if (!s)
+		return s;
+	__atomic_load_n(&g_set_kernel, __ATOMIC_RELAXED)(s, (unsigned char)c, n);
+	return s;
+}
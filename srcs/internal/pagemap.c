@@ -0,0 +1,101 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+
+/*
+ * Two-level radix tree keyed by page number. The root lives in .bss and
+ * leaves are mapped on demand, so untouched parts cost no memory.
+ */
+static t_zone **g_pagemap[1UL << PAGEMAP_ROOT_BITS];
+
+#define PAGEMAP_LEAF_ENTRIES (1UL << PAGEMAP_LEAF_BITS)
+#define PAGEMAP_KEY(addr) ((uintptr_t)(addr) >> PAGEMAP_SHIFT)
+
+/**
+ * Get the leaf covering a page number, mapping it if create is set
+ */
+static t_zone **pagemap_leaf(uintptr_t key, t_bool create) {
+	uintptr_t root_index = key >> PAGEMAP_LEAF_BITS;
+
+	if (root_index >= (1UL << PAGEMAP_ROOT_BITS))
+		return NULL;
+
+	t_zone **leaf = __atomic_load_n(&g_pagemap[root_index], __ATOMIC_ACQUIRE);
+	if (leaf || !create)
+		return leaf;
+
+	size_t leaf_size = PAGEMAP_LEAF_ENTRIES * sizeof(t_zone *);
+	t_zone **new_leaf = mmap(NULL, leaf_size, PROT_READ | PROT_WRITE,
+	                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (new_leaf == MAP_FAILED)
+		return NULL;
+	// Another thread may have installed the leaf in the meantime
+	if (!__atomic_compare_exchange_n(&g_pagemap[root_index], &leaf, new_leaf,
+	                                 false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		munmap(new_leaf, leaf_size);
+		return leaf;
+	}
+	return new_leaf;
+}
+
+/**
+ * Point every page of [start, start + size) at value
+ */
+static t_bool pagemap_set(void *start, size_t size, t_zone *value) {
+	uintptr_t first = PAGEMAP_KEY(start);
+	uintptr_t last = PAGEMAP_KEY((char *)start + size - 1);
+
+	for (uintptr_t key = first; key <= last; key++) {
+		t_zone **leaf = pagemap_leaf(key, value != NULL);
+		if (!leaf) {
+			if (value)
+				return false;
+			continue;
+		}
+		__atomic_store_n(&leaf[key & (PAGEMAP_LEAF_ENTRIES - 1)], value,
+		                 __ATOMIC_RELEASE);
+	}
+	return true;
+}
+
+/**
+ * Bytes of a zone that must be mapped: a LARGE zone holds a single block
+ * whose header and first data byte are all a pointer can fall on, other
+ * zones are mapped whole
+ */
+static size_t pagemap_span(t_zone *zone) {
+	if (zone->type == ZONE_LARGE)
+		return (char *)zone->blocks - (char *)zone->start + BLOCK_METADATA_SIZE +
+		       1;
+	return zone->total_size;
+}
+
+t_bool pagemap_register_at(t_zone *zone, void *start) {
+	size_t span = pagemap_span(zone);
+
+	if (pagemap_set(start, span, (t_zone *)start))
+		return true;
+	pagemap_set(start, span, NULL);
+	return false;
+}
+
+void pagemap_unregister_at(t_zone *zone, void *start) {
+	pagemap_set(start, pagemap_span(zone), NULL);
+}
+
+t_bool pagemap_register(t_zone *zone) {
+	return pagemap_register_at(zone, zone->start);
+}
+
+void pagemap_unregister(t_zone *zone) {
+	pagemap_unregister_at(zone, zone->start);
+}
+
+t_zone *pagemap_lookup(void *ptr) {
+	uintptr_t key = PAGEMAP_KEY(ptr);
+	t_zone **leaf = pagemap_leaf(key, false);
+
+	if (!leaf)
+		return NULL;
+	return __atomic_load_n(&leaf[key & (PAGEMAP_LEAF_ENTRIES - 1)],
+	                       __ATOMIC_ACQUIRE);
+}
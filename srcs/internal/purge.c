@@ -0,0 +1,113 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+
+/**
+ * Hand the whole pages between start and end back to the kernel
+ * MADV_FREE lets the kernel reclaim them lazily, MADV_DONTNEED is the
+ * fallback for kernels or mappings without it, and leaves zero pages
+ * behind. Returns the number of pages
+ */
+static size_t purge_range(void *start, void *end, t_bool *zeroed) {
+	uintptr_t first = PAGE_ALIGN((uintptr_t)start);
+	uintptr_t last = PAGE_FLOOR(end);
+
+	*zeroed = false;
+	if (last <= first)
+		return 0;
+	if (madvise((void *)first, last - first, MADV_FREE) != 0) {
+		if (madvise((void *)first, last - first, MADV_DONTNEED) != 0)
+			return 0;
+		*zeroed = true;
+	}
+	return (last - first) / PAGE_SIZE;
+}
+
+size_t block_purgeable_pages(t_block *block) {
+	uintptr_t first =
+	  PAGE_ALIGN((uintptr_t)BLOCK_DATA(block) + sizeof(t_free_links));
+	uintptr_t last = PAGE_FLOOR((char *)BLOCK_DATA(block) + BLOCK_SIZE(block));
+
+	return last > first ? (last - first) / PAGE_SIZE : 0;
+}
+
+/**
+ * Purge the free blocks of a zone big enough to span a whole page, until
+ * purged reaches max_pages
+ */
+static void purge_zone(t_zone *zone, size_t first_bin, size_t *purged,
+                       size_t max_pages) {
+	uint64_t bins = zone->free_map & ~((1UL << first_bin) - 1);
+
+	while (bins && *purged < max_pages) {
+		size_t bin = __builtin_ctzl(bins);
+		bins &= bins - 1;
+		for (t_block *block = zone->free_bins[bin];
+		     block && *purged < max_pages; block = FREE_LINKS(block)->next) {
+			t_bool zeroed;
+
+			if (block->size & BLOCK_PURGED)
+				continue;
+			// The links stay in the first page of the data area
+			*purged += purge_range(
+			  (char *)BLOCK_DATA(block) + sizeof(t_free_links),
+			  (char *)BLOCK_DATA(block) + BLOCK_SIZE(block), &zeroed);
+			block->size &= ~(size_t)BLOCK_ZEROED;
+			block->size |= BLOCK_PURGED | (zeroed ? BLOCK_ZEROED : 0);
+		}
+	}
+}
+
+size_t purge_arena(t_arena *arena, size_t max_pages) {
+	// Smaller blocks cannot hold a whole page
+	size_t first_bin = free_bin_index(PAGE_SIZE);
+	size_t purged = 0;
+
+	// SMALL zones holding such a block, found through the zone index
+	uint64_t buckets = arena->zone_map[ZONE_SMALL] & ~((1UL << first_bin) - 1);
+	while (buckets && purged < max_pages) {
+		size_t bucket = __builtin_ctzl(buckets);
+		buckets &= buckets - 1;
+		for (t_zone *zone = arena->zone_index[ZONE_SMALL][bucket];
+		     zone && purged < max_pages; zone = zone->index_next)
+			purge_zone(zone, first_bin, &purged, max_pages);
+	}
+
+	// Slabs have no per-object metadata, so only empty ones are purged
+	for (size_t i = 0; i < TINY_CLASSES && purged < max_pages; i++) {
+		for (t_zone *zone = arena->slabs[i]; zone && purged < max_pages;
+		     zone = zone->slab_next) {
+			t_bool zeroed;
+
+			if (zone->used_blocks || zone->purged)
+				continue;
+			purged += purge_range(zone->slab_objects,
+			                      (char *)zone->start + zone->total_size, &zeroed);
+			zone->purged = true;
+		}
+	}
+
+	arena->purged_pages += purged;
+	// Nothing dirty is left once the whole arena has been visited
+	if (purged < max_pages || purged >= arena->dirty_pages)
+		arena->dirty_pages = 0;
+	else
+		arena->dirty_pages -= purged;
+	return purged;
+}
+
+void purge_decay(t_arena *arena, size_t epoch) {
+	// Pages made dirty since the previous tick
+	size_t fresh = 0;
+	if (arena->dirty_pages > arena->decay_last)
+		fresh = arena->dirty_pages - arena->decay_last;
+	arena->decay_dirty[epoch % DECAY_STEPS] = fresh;
+
+	// Pages freed age ticks ago may stay dirty for DECAY_STEPS - age more
+	size_t allowed = 0;
+	for (size_t age = 0; age < DECAY_STEPS; age++)
+		allowed += arena->decay_dirty[(epoch + DECAY_STEPS - age) % DECAY_STEPS] *
+		           (DECAY_STEPS - age) / DECAY_STEPS;
+	if (arena->dirty_pages > allowed)
+		purge_arena(arena, arena->dirty_pages - allowed);
+	arena->decay_last = arena->dirty_pages;
+}
@@ -0,0 +1,112 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+#include <time.h>
+
+/* Held by the purger for the length of a tick, and across fork() */
+static pthread_mutex_t g_purger_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_purger_once = PTHREAD_ONCE_INIT;
+static t_bool g_purger_running = false;
+static size_t g_purger_epoch = 0;
+
+/**
+ * Unmap the empty zones retained for a whole decay time, down to the
+ * FT_M_RETAIN_ZONES kept for reuse
+ */
+static void purger_release_idle(t_arena *arena, size_t epoch) {
+	size_t retain = __atomic_load_n(&g_options.retain_zones, __ATOMIC_RELAXED);
+	t_zone *zone = arena->zones;
+
+	while (zone && arena->empty_zones > retain) {
+		t_zone *next = zone->next;
+
+		if (zone->retained && epoch - zone->empty_since >= DECAY_STEPS)
+			zone_release(zone);
+		zone = next;
+	}
+}
+
+/**
+ * One step of the decay: everything malloc() and free() leave behind when
+ * the purger runs, done without any work budget
+ */
+static void purger_tick(void) {
+	size_t epoch = __atomic_add_fetch(&g_purger_epoch, 1, __ATOMIC_RELAXED);
+
+	for (size_t i = 0; i < g_arena_count; i++) {
+		t_arena *arena = &g_arenas[i];
+
+		arena_lock(arena);
+		remote_free_drain(arena);
+		if (arena->defrag_zones)
+			defragment_step(arena, SIZE_MAX);
+		purge_decay(arena, epoch);
+		purger_release_idle(arena, epoch);
+		arena_unlock(arena);
+	}
+	large_cache_decay();
+}
+
+static void *purger_main(void *arg) {
+	(void)arg;
+	while (__atomic_load_n(&g_options.background_thread, __ATOMIC_RELAXED)) {
+		size_t tick_ms =
+		  __atomic_load_n(&g_options.decay_time, __ATOMIC_RELAXED) / DECAY_STEPS;
+		if (!tick_ms)
+			tick_ms = 1;
+		struct timespec tick = {.tv_sec = tick_ms / 1000,
+		                        .tv_nsec = (tick_ms % 1000) * 1000000};
+
+		nanosleep(&tick, NULL);
+		pthread_mutex_lock(&g_purger_mutex);
+		purger_tick();
+		pthread_mutex_unlock(&g_purger_mutex);
+	}
+	__atomic_store_n(&g_purger_running, false, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+/* A fork() never happens in the middle of a tick */
+static void purger_prefork(void) { pthread_mutex_lock(&g_purger_mutex); }
+
+static void purger_postfork_parent(void) {
+	pthread_mutex_unlock(&g_purger_mutex);
+}
+
+/* The child has no purger thread, the next free() starts one if needed */
+static void purger_postfork_child(void) {
+	pthread_mutex_init(&g_purger_mutex, NULL);
+	__atomic_store_n(&g_purger_running, false, __ATOMIC_RELAXED);
+}
+
+static void purger_register_fork(void) {
+	pthread_atfork(purger_prefork, purger_postfork_parent,
+	               purger_postfork_child);
+}
+
+void purger_start(void) {
+	t_bool expected = false;
+
+	if (!__atomic_load_n(&g_options.background_thread, __ATOMIC_RELAXED) ||
+	    __atomic_load_n(&g_purger_running, __ATOMIC_ACQUIRE))
+		return;
+	if (!__atomic_compare_exchange_n(&g_purger_running, &expected, true, false,
+	                                 __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		return;
+
+	pthread_once(&g_purger_once, purger_register_fork);
+	pthread_attr_t attr;
+	pthread_t thread;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&thread, &attr, purger_main, NULL) != 0)
+		__atomic_store_n(&g_purger_running, false, __ATOMIC_RELEASE);
+	pthread_attr_destroy(&attr);
+}
+
+t_bool purger_active(void) {
+	return __atomic_load_n(&g_purger_running, __ATOMIC_RELAXED);
+}
+
+size_t purger_epoch(void) {
+	return __atomic_load_n(&g_purger_epoch, __ATOMIC_RELAXED);
+}
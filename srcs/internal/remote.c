@@ -0,0 +1,73 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+
+/**
+ * Push a zone on its arena's list of zones with pending remote frees
+ */
+static void remote_zone_push(t_arena *arena, t_zone *zone) {
+	t_zone *head = __atomic_load_n(&arena->remote_zones, __ATOMIC_RELAXED);
+
+	do {
+		zone->remote_next = head;
+	} while (!__atomic_compare_exchange_n(&arena->remote_zones, &head, zone,
+	                                      true, __ATOMIC_RELEASE,
+	                                      __ATOMIC_RELAXED));
+}
+
+void remote_free_push(t_zone *zone, void *ptr) {
+	t_block *block = (t_block *)((char *)ptr - BLOCK_METADATA_SIZE);
+	// Keeps the zone mapped until the push is done and, when the zone gets
+	// queued, until its owner has taken it off the queue
+	__atomic_add_fetch(&zone->remote_pending, 1, __ATOMIC_RELAXED);
+	void *head = __atomic_load_n(&zone->remote_free, __ATOMIC_RELAXED);
+
+	// TINY objects were parked by the caller
+	if (zone->type != ZONE_TINY)
+		block->magic = REMOTE_MAGIC;
+	do {
+		*(void **)ptr = head;
+	} while (!__atomic_compare_exchange_n(&zone->remote_free, &head, ptr, true,
+	                                      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	// First pending block of this zone: let the owner know where to look
+	if (head == NULL)
+		remote_zone_push(zone->arena, zone);
+	else
+		__atomic_sub_fetch(&zone->remote_pending, 1, __ATOMIC_RELEASE);
+}
+
+void remote_free_drain(t_arena *arena) {
+	if (!__atomic_load_n(&arena->remote_zones, __ATOMIC_RELAXED)) {
+		// Zones emptied while a remote free was still in flight
+		if (arena->deferred_releases)
+			zone_release_deferred(arena);
+		return;
+	}
+
+	t_zone *zone = __atomic_exchange_n(&arena->remote_zones, NULL,
+	                                   __ATOMIC_ACQUIRE);
+	while (zone) {
+		// Read the link first: once the list is taken the zone may be re-queued
+		t_zone *next_zone = zone->remote_next;
+		void *ptr = __atomic_exchange_n(&zone->remote_free, NULL,
+		                                __ATOMIC_ACQUIRE);
+		__atomic_sub_fetch(&zone->remote_pending, 1, __ATOMIC_RELEASE);
+
+		while (ptr) {
+			void *next_ptr = *(void **)ptr;
+			t_block *block = (t_block *)((char *)ptr - BLOCK_METADATA_SIZE);
+
+			if (zone->type == ZONE_TINY) {
+				slab_unpark(zone, ptr);
+				slab_free(zone, ptr);
+			} else {
+				block->magic = MAGIC_NUMBER;
+				free_block(zone, block);
+			}
+			ptr = next_ptr;
+		}
+		zone = next_zone;
+	}
+	if (arena->deferred_releases)
+		zone_release_deferred(arena);
+}
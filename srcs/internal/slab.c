@@ -0,0 +1,183 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+
+static void slab_link(t_arena *arena, t_zone *zone) {
+	t_zone **head = &arena->slabs[TINY_CLASS(zone->slab_size)];
+
+	zone->slab_prev = NULL;
+	zone->slab_next = *head;
+	if (*head)
+		(*head)->slab_prev = zone;
+	*head = zone;
+}
+
+void slab_unlink(t_arena *arena, t_zone *zone) {
+	if (zone->slab_prev)
+		zone->slab_prev->slab_next = zone->slab_next;
+	else
+		arena->slabs[TINY_CLASS(zone->slab_size)] = zone->slab_next;
+	if (zone->slab_next)
+		zone->slab_next->slab_prev = zone->slab_prev;
+	zone->slab_prev = NULL;
+	zone->slab_next = NULL;
+}
+
+/**
+ * Map a slab for one size class: zone header and bitmap first, then the
+ * objects, so that no object carries metadata of its own
+ */
+static t_zone *create_slab(t_arena *arena, size_t size) {
+	t_zone *zone = create_zone(arena, ZONE_TINY, TINY_ZONE_SIZE);
+	if (!zone)
+		return NULL;
+
+	size_t capacity = (zone->total_size - ZONE_HEADER_SIZE) / size;
+	if (capacity > SLAB_MAX_OBJECTS)
+		capacity = SLAB_MAX_OBJECTS;
+	size_t words = (capacity + 63) / 64;
+	// Objects start on the largest power of two dividing their size, so
+	// memalign() can take them for any alignment their size is a multiple of
+	size_t boundary = size & -size;
+	size_t objects_offset =
+	  (ZONE_HEADER_SIZE + 2 * words * sizeof(uint64_t) + boundary - 1) &
+	  ~(boundary - 1);
+	zone->slab_bitmap = (uint64_t *)((char *)zone + ZONE_HEADER_SIZE);
+	zone->slab_parked = zone->slab_bitmap + words;
+	capacity = (zone->total_size - objects_offset) / size;
+	if (capacity > SLAB_MAX_OBJECTS)
+		capacity = SLAB_MAX_OBJECTS;
+	words = (capacity + 63) / 64;
+
+	zone->slab_size = size;
+	zone->slab_capacity = capacity;
+	zone->slab_objects = (char *)zone + objects_offset;
+	for (size_t i = 0; i < words; i++) {
+		zone->slab_bitmap[i] = ~0ULL;
+		zone->slab_parked[i] = 0;
+	}
+	if (capacity % 64)
+		zone->slab_bitmap[words - 1] = (1ULL << (capacity % 64)) - 1;
+	zone->slab_summary = (words == 64) ? ~0ULL : (1ULL << words) - 1;
+	zone->free_space = capacity * size;
+	// An empty slab is not fragmented: it goes back to the kernel whole
+	t_zone_stats *stats = ZONE_STATS(zone);
+	stats->metadata += zone->total_size - zone->free_space;
+	stats->free += zone->free_space;
+	stats->free_blocks += capacity;
+	slab_link(arena, zone);
+	return zone;
+}
+
+/**
+ * Get the object index of ptr, rejecting pointers that are not the start
+ * of an object
+ */
+static t_bool slab_index(t_zone *zone, void *ptr, size_t *index) {
+	if ((char *)ptr < zone->slab_objects)
+		return false;
+
+	size_t offset = (char *)ptr - zone->slab_objects;
+	if (offset % zone->slab_size)
+		return false;
+	*index = offset / zone->slab_size;
+	return *index < zone->slab_capacity;
+}
+
+void *slab_alloc(t_arena *arena, size_t size) {
+	size = ALIGN(size);
+	t_zone *zone = arena->slabs[TINY_CLASS(size)];
+	if (!zone)
+		zone = create_slab(arena, size);
+	if (!zone)
+		return NULL;
+
+	size_t word = __builtin_ctzll(zone->slab_summary);
+	size_t bit = __builtin_ctzll(zone->slab_bitmap[word]);
+	zone->slab_bitmap[word] &= ~(1ULL << bit);
+	if (!zone->slab_bitmap[word])
+		zone->slab_summary &= ~(1ULL << word);
+	// Full slabs leave the list until an object comes back
+	if (!zone->slab_summary)
+		slab_unlink(arena, zone);
+	if (!zone->used_blocks)
+		zone_reuse(zone);
+	zone->used_blocks++;
+	zone->free_space -= size;
+	t_zone_stats *stats = ZONE_STATS(zone);
+	stats->free -= size;
+	stats->free_blocks--;
+	if (zone->used_blocks == 1)
+		stats->fragmented += zone->free_space;
+	else
+		stats->fragmented -= size;
+	return zone->slab_objects + (word * 64 + bit) * size;
+}
+
+t_bool slab_owns(t_zone *zone, void *ptr) {
+	size_t index;
+
+	if (!slab_index(zone, ptr, &index))
+		return false;
+	return !(zone->slab_bitmap[index / 64] & (1ULL << (index % 64)));
+}
+
+t_bool slab_park(t_zone *zone, void *ptr) {
+	size_t index = ((char *)ptr - zone->slab_objects) / zone->slab_size;
+	uint64_t bit = 1ULL << (index % 64);
+
+	return !(__atomic_fetch_or(&zone->slab_parked[index / 64], bit,
+	                           __ATOMIC_ACQ_REL) &
+	         bit);
+}
+
+void slab_unpark(t_zone *zone, void *ptr) {
+	size_t index = ((char *)ptr - zone->slab_objects) / zone->slab_size;
+
+	__atomic_fetch_and(&zone->slab_parked[index / 64], ~(1ULL << (index % 64)),
+	                   __ATOMIC_RELEASE);
+}
+
+t_bool slab_is_parked(t_zone *zone, size_t index) {
+	return (__atomic_load_n(&zone->slab_parked[index / 64], __ATOMIC_RELAXED) >>
+	        (index % 64)) &
+	       1;
+}
+
+t_bool slab_free(t_zone *zone, void *ptr) {
+	size_t index;
+
+	if (!slab_index(zone, ptr, &index))
+		return false;
+
+	uint64_t *word = &zone->slab_bitmap[index / 64];
+	uint64_t bit = 1ULL << (index % 64);
+	if (*word & bit)
+		return false; // Already free
+	// Parked: only whoever parked it may return it
+	if (__atomic_load_n(&zone->slab_parked[index / 64], __ATOMIC_ACQUIRE) & bit)
+		return false;
+
+	t_bool was_full = (zone->slab_summary == 0);
+	*word |= bit;
+	zone->slab_summary |= 1ULL << (index / 64);
+	if (was_full)
+		slab_link(zone->arena, zone);
+	zone->used_blocks--;
+	zone->free_space += zone->slab_size;
+	t_zone_stats *stats = ZONE_STATS(zone);
+	stats->free += zone->slab_size;
+	stats->free_blocks++;
+	if (!zone->used_blocks)
+		stats->fragmented -= zone->free_space - zone->slab_size;
+	else
+		stats->fragmented += zone->slab_size;
+
+	// An empty slab is either kept, its pages purged later, or unmapped
+	if (!zone->used_blocks) {
+		if (zone_retain(zone))
+			zone->arena->dirty_pages += zone->free_space / PAGE_SIZE;
+		else
+			zone_release(zone);
+	}
+	return true;
+}
@@ -1,13 +1,27 @@
 #include "malloc.h"
 #include "malloc_internal.h"
 
-void init_malloc_system(void) {
-	static t_bool initialized = false;
+static void init_arenas(void) {
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t count = (cpus > 0 ? (size_t)cpus : 1) * ARENAS_PER_CPU;
 
-	if (!initialized) {
-		pthread_mutex_init(&g_malloc_mutex, NULL);
-		initialized = true;
+	if (count > MAX_ARENAS)
+		count = MAX_ARENAS;
+	for (size_t i = 0; i < count; i++) {
+		pthread_mutex_init(&g_arenas[i].mutex, NULL);
+		g_arenas[i].zones = NULL;
+		g_arenas[i].index = i;
+		g_arenas[i].lock_count = 0;
+		g_arenas[i].contended = 0;
+		g_arenas[i].remote_zones = NULL;
 	}
+	__atomic_store_n(&g_arena_count, count, __ATOMIC_RELEASE);
+}
+
+void init_malloc_system(void) {
+	static pthread_once_t initialized = PTHREAD_ONCE_INIT;
+
+	pthread_once(&initialized, init_arenas);
 }
 
 size_t get_max_allocation_size(void) {
@@ -0,0 +1,158 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+
+static __thread t_tcache g_tcache __attribute__((tls_model("initial-exec")));
+static pthread_key_t g_tcache_key;
+static pthread_once_t g_tcache_once = PTHREAD_ONCE_INIT;
+
+static void tcache_destroy(void *arg) {
+	(void)arg;
+	tcache_flush();
+	g_tcache.disabled = true;
+}
+
+static void tcache_create_key(void) {
+	pthread_key_create(&g_tcache_key, tcache_destroy);
+}
+
+/**
+ * Arm the thread exit destructor the first time this thread caches a block
+ */
+static void tcache_register(void) {
+	pthread_once(&g_tcache_once, tcache_create_key);
+	pthread_setspecific(g_tcache_key, &g_tcache);
+	g_tcache.registered = true;
+}
+
+/**
+ * Return up to count blocks of one bin to the arenas owning them, with one
+ * lock of the calling thread's arena for the whole run
+ */
+static void tcache_drain_bin(size_t index, unsigned int count) {
+	void *ptrs[TCACHE_MAX_COUNT];
+	size_t taken = 0;
+
+	while (count-- && g_tcache.bins[index]) {
+		void *ptr = g_tcache.bins[index];
+		g_tcache.bins[index] = *(void **)ptr;
+		g_tcache.counts[index]--;
+
+		if (TCACHE_IS_TINY(index))
+			slab_unpark(pagemap_lookup(ptr), ptr);
+		else
+			((t_block *)((char *)ptr - BLOCK_METADATA_SIZE))->magic =
+			  MAGIC_NUMBER;
+		ptrs[taken++] = ptr;
+	}
+	free_memory_batch(ptrs, taken, false);
+}
+
+void *tcache_get(size_t needed_size) {
+	if (needed_size > TCACHE_MAX_SIZE)
+		return NULL;
+
+	size_t index = TCACHE_INDEX(needed_size);
+	void *ptr = g_tcache.bins[index];
+	if (!ptr)
+		return NULL;
+
+	g_tcache.bins[index] = *(void **)ptr;
+	g_tcache.counts[index]--;
+	if (TCACHE_IS_TINY(index))
+		slab_unpark(pagemap_lookup(ptr), ptr);
+	else
+		((t_block *)((char *)ptr - BLOCK_METADATA_SIZE))->magic = MAGIC_NUMBER;
+	return ptr;
+}
+
+/**
+ * Park a verified block of zone in bin index of the calling thread's cache
+ * Returns FALSE if the bin is full and drain is not set
+ */
+static t_bool tcache_push(t_zone *zone, void *ptr, size_t index,
+                          t_bool drain) {
+	if (g_tcache.counts[index] >= TCACHE_MAX_COUNT && !drain)
+		return false;
+	// Object already parked by some thread: swallow the double free
+	if (TCACHE_IS_TINY(index) && !slab_park(zone, ptr))
+		return true;
+	if (!g_tcache.registered)
+		tcache_register();
+
+	// Bin is full: hand half of it back in one locked pass
+	if (g_tcache.counts[index] >= TCACHE_MAX_COUNT)
+		tcache_drain_bin(index, TCACHE_MAX_COUNT / 2);
+
+	if (!TCACHE_IS_TINY(index))
+		((t_block *)((char *)ptr - BLOCK_METADATA_SIZE))->magic = TCACHE_MAGIC;
+	*(void **)ptr = g_tcache.bins[index];
+	g_tcache.bins[index] = ptr;
+	g_tcache.counts[index]++;
+	return true;
+}
+
+/**
+ * tcache_put(), draining the block's bin when it is full only if drain is set
+ */
+static t_bool tcache_park(void *ptr, t_bool drain) {
+	size_t index;
+
+	if (g_tcache.disabled)
+		return false;
+
+	t_zone *zone = pagemap_lookup(ptr);
+	t_block *block = (t_block *)((char *)ptr - BLOCK_METADATA_SIZE);
+	if (!zone)
+		return false;
+	if (zone->type == ZONE_TINY) {
+		if (!slab_owns(zone, ptr))
+			return false;
+		index = TCACHE_INDEX(zone->slab_size);
+	} else {
+		if (block->magic != MAGIC_NUMBER || BLOCK_IS_FREE(block) ||
+		    BLOCK_SIZE(block) > TCACHE_MAX_SIZE ||
+		    BLOCK_SIZE(block) <= TINY_MAX_SIZE)
+			return false;
+		index = TCACHE_INDEX(BLOCK_SIZE(block));
+	}
+	return tcache_push(zone, ptr, index, drain);
+}
+
+t_bool tcache_put(void *ptr) {
+	return tcache_park(ptr, true);
+}
+
+t_bool tcache_put_spare(void *ptr) {
+	return tcache_park(ptr, false);
+}
+
+t_bool tcache_put_sized(void *ptr, size_t needed_size) {
+	size_t index = TCACHE_INDEX(needed_size);
+
+	if (g_tcache.disabled || needed_size > TCACHE_MAX_SIZE)
+		return false;
+
+	t_zone *zone = pagemap_lookup(ptr);
+	if (!zone)
+		return false;
+	// The size tells which block this is: only the cheap checks are made
+	if (TCACHE_IS_TINY(index) && zone->type == ZONE_TINY &&
+	    zone->slab_size == needed_size) {
+		// Back in its slab already: leave the double free to the full checks
+		if (!slab_owns(zone, ptr))
+			return tcache_put(ptr);
+		return tcache_push(zone, ptr, index, true);
+	}
+	t_block *block = (t_block *)((char *)ptr - BLOCK_METADATA_SIZE);
+	if (!TCACHE_IS_TINY(index) && zone->type == ZONE_SMALL &&
+	    block->magic == MAGIC_NUMBER && block->size == needed_size)
+		return tcache_push(zone, ptr, index, true);
+	// A block resized in place, or a wrong size: take the full checks
+	return tcache_put(ptr);
+}
+
+void tcache_flush(void) {
+	for (size_t i = 0; i < TCACHE_BINS; i++)
+		if (g_tcache.counts[i])
+			tcache_drain_bin(i, g_tcache.counts[i]);
+}
@@ -8,6 +8,8 @@ t_bool is_valid_pointer(void *ptr) {
 	t_zone *zone = find_zone_containing(ptr);
 	if (!zone)
 		return false;
+	if (zone->type == ZONE_TINY)
+		return slab_owns(zone, ptr);
 
 	// Calculate pointer to block metadata
 	t_block *block = (t_block *)((char *)ptr - BLOCK_METADATA_SIZE);
@@ -24,7 +26,7 @@ t_bool verify_block(t_block *block) {
 		return false;
 
 	// Check if block is currently allocated (not free)
-	if (block->is_free)
+	if (BLOCK_IS_FREE(block))
 		return false;
 
 	return true;
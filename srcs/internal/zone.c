@@ -1,87 +1,464 @@
+#define _GNU_SOURCE
 #include "malloc.h"
 #include "malloc_internal.h"
 
-t_zone *create_zone(zone_type_t type, size_t size) {
-	// Make sure size is page-aligned
-	size = ALIGN(size);
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
 
-	// Map memory for the zone
-	void *zone_memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
-	                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+/**
+ * Length of the mapping of a zone of size bytes: whole pages, or whole huge
+ * pages for the zones that FT_M_HUGE_PAGES backs with huge pages
+ */
+static size_t zone_mapping_size(zone_type_t type, size_t size,
+                                t_bool *huge) {
+	size = PAGE_ALIGN(size);
+	*huge = __atomic_load_n(&g_options.huge_pages, __ATOMIC_RELAXED) &&
+	        (type == ZONE_SMALL ||
+	         (type == ZONE_LARGE && size >= HUGE_PAGE_SIZE));
+	return *huge ? HUGE_ALIGN(size) : size;
+}
 
-	if (zone_memory == MAP_FAILED)
+/**
+ * Map size bytes so that start + offset falls on an alignment boundary,
+ * alignment being a multiple of the page size. An alignment more is mapped,
+ * then the unaligned ends are cut
+ */
+static void *zone_map_at(size_t size, size_t alignment, size_t offset) {
+	char *raw = mmap(NULL, size + alignment, PROT_READ | PROT_WRITE,
+	                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED)
 		return NULL;
 
+	char *start =
+	  (char *)(((uintptr_t)raw + offset + alignment - 1) & ~(alignment - 1)) -
+	  offset;
+	if (start > raw)
+		munmap(raw, start - raw);
+	munmap(start + size, raw + alignment - start);
+	return start;
+}
+
+/**
+ * Map size bytes starting on a huge page boundary and ask for transparent
+ * huge pages
+ */
+static void *zone_map_aligned(size_t size) {
+	void *start = zone_map_at(size, HUGE_PAGE_SIZE, 0);
+
+	if (start)
+		madvise(start, size, MADV_HUGEPAGE);
+	return start;
+}
+
+/**
+ * Map size bytes for a zone. Huge zones use hugetlb pages when the system
+ * has some reserved, transparent huge pages otherwise
+ */
+static void *zone_map(size_t size, t_bool huge) {
+	int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	void *memory;
+
+	if (huge) {
+		memory = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		              flags | MAP_HUGETLB | MAP_HUGE_2MB, -1, 0);
+		if (memory != MAP_FAILED)
+			return memory;
+		return zone_map_aligned(size);
+	}
+	memory = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+	return memory == MAP_FAILED ? NULL : memory;
+}
+
+/**
+ * Set up the zone header at the start of a new mapping and link the zone
+ * into its arena. The first block of a SMALL or LARGE zone starts at
+ * block_offset
+ */
+static t_zone *zone_setup(t_arena *arena, void *zone_memory, zone_type_t type,
+                          size_t size, t_bool fresh, size_t block_offset) {
 	// Initialize zone structure at the beginning of the mapped memory
 	t_zone *zone = (t_zone *)zone_memory;
 	zone->start = zone_memory;
 	zone->total_size = size;
 	zone->type = type;
 	zone->next = NULL;
-	zone->free_space = size - sizeof(t_zone);
+	zone->prev = NULL;
+	zone->free_space = size - block_offset;
 	zone->used_blocks = 0;
 	zone->blocks = NULL;
+	zone->arena = arena;
+	zone->remote_free = NULL;
+	zone->remote_next = NULL;
+	zone->remote_pending = 0;
+	zone->release_deferred = false;
+	zone->retained = false;
+	zone->purged = false;
+	zone->empty_since = 0;
+	zone->slab_size = 0;
+	zone->slab_capacity = 0;
+	zone->slab_summary = 0;
+	zone->slab_bitmap = NULL;
+	zone->slab_parked = NULL;
+	zone->slab_objects = NULL;
+	zone->slab_prev = NULL;
+	zone->slab_next = NULL;
+	zone->free_map = 0;
+	block_memset(zone->free_bins, 0, sizeof(zone->free_bins));
+	zone->free_count = 0;
+	zone->total_free = 0;
+	zone->largest_free = 0;
+	zone->defrag_queued = false;
+	zone->defrag_cursor = 0;
+	zone->defrag_next = NULL;
+	zone->index_bin = FREE_BINS;
+	zone->index_prev = NULL;
+	zone->index_next = NULL;
+	// TINY slabs are carved by slab.c
+	if (type != ZONE_TINY)
+		zone->blocks = (t_block *)((char *)zone_memory + block_offset);
+
+	// Pointers are mapped back to their zone through the page map
+	if (!pagemap_register(zone)) {
+		munmap(zone_memory, size);
+		return NULL;
+	}
 
-	// Create initial free block
-	t_block *block = (t_block *)((char *)zone_memory + sizeof(t_zone));
-	block->next = NULL;
-	block->prev = NULL;
-	block->size = zone->free_space - BLOCK_METADATA_SIZE;
-	block->magic = MAGIC_NUMBER;
-	block->is_free = true;
-	block->offset = sizeof(t_zone);
+	if (type != ZONE_TINY) {
+		// Create initial free block
+		t_block *block = zone->blocks;
+		block->prev = 0;
+		// Pages fresh from mmap() read as zero
+		block->size = (zone->free_space - BLOCK_METADATA_SIZE) | BLOCK_FREE |
+		              (fresh ? BLOCK_ZEROED : 0);
+		block->magic = MAGIC_NUMBER;
+		free_bin_insert(zone, block);
+	}
 
-	zone->blocks = block;
+	t_zone_stats *stats = ZONE_STATS(zone);
+	stats->zones++;
+	stats->mapped += size;
+	if (type != ZONE_TINY)
+		stats->metadata += block_offset + BLOCK_METADATA_SIZE;
 
-	// Add to global zones list
-	if (g_zones == NULL) {
-		g_zones = zone;
+	// Add to the arena's zones list
+	if (arena->zones == NULL) {
+		arena->zones = zone;
 	} else {
-		zone->next = g_zones;
-		g_zones = zone;
+		zone->next = arena->zones;
+		arena->zones->prev = zone;
+		arena->zones = zone;
 	}
 
 	return zone;
 }
 
-t_zone *find_zone_for_size(size_t size) {
-	zone_type_t type = GET_ZONE_TYPE(size);
-	t_zone *zone = g_zones;
+t_zone *create_zone(t_arena *arena, zone_type_t type, size_t size) {
+	// Make sure size is made of whole (huge) pages
+	t_bool huge;
+	size = zone_mapping_size(type, size, &huge);
+
+	// Map memory for the zone, reusing a freed LARGE mapping when possible
+	void *zone_memory = NULL;
+	t_bool fresh = false;
+	if (type == ZONE_LARGE)
+		zone_memory = large_cache_get(&size);
+	if (!zone_memory) {
+		zone_memory = zone_map(size, huge);
+		if (!zone_memory)
+			return NULL;
+		fresh = true;
+	}
+	return zone_setup(arena, zone_memory, type, size, fresh, ZONE_HEADER_SIZE);
+}
 
-	while (zone) {
-		if (zone->type == type && zone->free_space >= size) {
-			t_block *block = find_free_block(zone, size);
-			if (block)
-				return zone;
+t_zone *create_aligned_zone(t_arena *arena, size_t size, size_t alignment) {
+	// Mappings start on a page: the data only has to skip the headers
+	size_t step = alignment < (size_t)PAGE_SIZE ? alignment : (size_t)PAGE_SIZE;
+	size_t offset = (ZONE_HEADER_SIZE + BLOCK_METADATA_SIZE + step - 1) &
+	                ~(step - 1);
+	if (size > SIZE_MAX - offset - HUGE_PAGE_SIZE - alignment)
+		return NULL;
+
+	void *zone_memory = NULL;
+	t_bool fresh = true;
+	t_bool huge;
+	size_t total_size;
+	if (alignment <= (size_t)PAGE_SIZE) {
+		total_size = zone_mapping_size(ZONE_LARGE, offset + size, &huge);
+		zone_memory = large_cache_get(&total_size);
+		fresh = !zone_memory;
+		if (!zone_memory)
+			zone_memory = zone_map(total_size, huge);
+	} else {
+		// Larger alignments are met by where the mapping starts
+		total_size = PAGE_ALIGN(offset + size);
+		zone_memory = zone_map_at(total_size, alignment, offset);
+	}
+	if (!zone_memory)
+		return NULL;
+	return zone_setup(arena, zone_memory, ZONE_LARGE, total_size, fresh,
+	                  offset - BLOCK_METADATA_SIZE);
+}
+
+/**
+ * Move a mapping to a new address without copying its pages
+ * The target is reserved and registered first, so that the page map can
+ * find the zone as soon as it has moved
+ */
+static void *zone_move(t_zone *zone, size_t total_size, t_bool huge) {
+	// The old header is gone once the mapping has moved
+	void *old_start = zone->start;
+	size_t old_size = zone->total_size;
+
+	// A huge zone lands on a huge page boundary, keeping its kind of pages
+	void *target = huge ? zone_map_aligned(total_size)
+	                    : zone_map(total_size, false);
+	if (!target)
+		return NULL;
+	if (!pagemap_register_at(zone, target)) {
+		munmap(target, total_size);
+		return NULL;
+	}
+
+	// Forget the old pages before another mapping can take their place
+	pagemap_unregister(zone);
+	void *moved = mremap(old_start, old_size, total_size,
+	                     MREMAP_MAYMOVE | MREMAP_FIXED, target);
+	if (moved == MAP_FAILED) {
+		// The leaf of the old pages still exists, this cannot fail
+		pagemap_register(zone);
+		pagemap_unregister_at(zone, target);
+		munmap(target, total_size);
+		return NULL;
+	}
+	return moved;
+}
+
+t_zone *zone_resize(t_zone *zone, size_t size) {
+	// The block keeps its offset, and so its alignment within a page
+	size_t offset = (char *)zone->blocks - (char *)zone->start;
+	t_bool huge;
+	size_t total_size = zone_mapping_size(
+	  ZONE_LARGE, size + offset + BLOCK_METADATA_SIZE, &huge);
+
+	if (zone->type != ZONE_LARGE || total_size < size)
+		return NULL;
+	if (total_size == zone->total_size)
+		return zone;
+
+	// Shrinking, or growing into free neighbouring pages, keeps the address
+	void *start = mremap(zone->start, zone->total_size, total_size, 0);
+	if (start == MAP_FAILED) {
+		start = zone_move(zone, total_size, huge);
+		if (!start)
+			return NULL;
+	}
+	// The zone may have grown past the huge page threshold
+	if (huge)
+		madvise(start, total_size, MADV_HUGEPAGE);
+
+	zone = (t_zone *)start;
+	ZONE_STATS(zone)->mapped += total_size - zone->total_size;
+	zone->start = start;
+	zone->total_size = total_size;
+	zone->blocks = (t_block *)((char *)start + offset);
+	zone->blocks->size = total_size - offset - BLOCK_METADATA_SIZE;
+
+	// Neighbours in the arena list still point at the old address
+	if (zone->prev)
+		zone->prev->next = zone;
+	else
+		zone->arena->zones = zone;
+	if (zone->next)
+		zone->next->prev = zone;
+	return zone;
+}
+
+void zone_reuse(t_zone *zone) {
+	if (zone->retained) {
+		zone->retained = false;
+		zone->arena->empty_zones--;
+	}
+	zone->purged = false;
+}
+
+t_bool zone_retain(t_zone *zone) {
+	t_arena *arena = zone->arena;
+
+	// The background purger unmaps the zones that stay empty for too long
+	if (!purger_active() &&
+	    arena->empty_zones >=
+	      __atomic_load_n(&g_options.retain_zones, __ATOMIC_RELAXED))
+		return false;
+	zone->retained = true;
+	zone->empty_since = purger_epoch();
+	arena->empty_zones++;
+	return true;
+}
+
+/**
+ * Take what is left of a zone out of the counters of its arena
+ */
+static void zone_stats_remove(t_zone *zone) {
+	t_zone_stats *stats = ZONE_STATS(zone);
+
+	stats->zones--;
+	stats->mapped -= zone->total_size;
+	if (zone->type == ZONE_TINY) {
+		stats->metadata -=
+		  zone->total_size - zone->slab_capacity * zone->slab_size;
+		stats->free -= zone->free_space;
+		stats->free_blocks -= zone->slab_capacity - zone->used_blocks;
+		if (zone->used_blocks)
+			stats->fragmented -= zone->free_space;
+		return;
+	}
+	stats->metadata -=
+	  (char *)zone->blocks - (char *)zone->start +
+	  (zone->used_blocks + zone->free_count) * BLOCK_METADATA_SIZE;
+	stats->free -= zone->total_free;
+	stats->free_blocks -= zone->free_count;
+	stats->fragmented -= zone->total_free - zone->largest_free;
+}
+
+t_bool zone_release(t_zone *zone) {
+	t_arena *arena = zone->arena;
+
+	// A thread still pushing a remote free, or the list of zones with
+	// remote frees, may reach the zone until its owner drains it
+	if (__atomic_load_n(&zone->remote_pending, __ATOMIC_ACQUIRE)) {
+		if (!zone->release_deferred) {
+			zone->release_deferred = true;
+			arena->deferred_releases++;
+		}
+		return false;
+	}
+	if (zone->release_deferred) {
+		zone->release_deferred = false;
+		arena->deferred_releases--;
+	}
+
+	if (zone->prev)
+		zone->prev->next = zone->next;
+	else
+		arena->zones = zone->next;
+	if (zone->next)
+		zone->next->prev = zone->prev;
+	zone_index_remove(zone);
+	if (zone->type == ZONE_TINY)
+		slab_unlink(arena, zone);
+	if (zone->defrag_queued)
+		defragment_forget(zone);
+	if (zone->retained)
+		arena->empty_zones--;
+	pagemap_unregister(zone);
+	zone_stats_remove(zone);
+
+	if (zone->type == ZONE_LARGE) {
+		large_cache_put(zone, zone->total_size);
+	} else {
+		munmap(zone->start, zone->total_size);
+		arena->released_zones++;
+	}
+	return true;
+}
+
+void zone_release_deferred(t_arena *arena) {
+	t_zone *zone = arena->zones;
+
+	while (zone && arena->deferred_releases) {
+		t_zone *next = zone->next;
+
+		if (zone->release_deferred &&
+		    !__atomic_load_n(&zone->remote_pending, __ATOMIC_ACQUIRE)) {
+			// Allocated from again since: nothing left to release
+			if (zone->used_blocks) {
+				zone->release_deferred = false;
+				arena->deferred_releases--;
+			} else
+				zone_release(zone);
 		}
-		zone = zone->next;
+		zone = next;
 	}
+}
+
+void zone_index_remove(t_zone *zone) {
+	if (zone->index_bin == FREE_BINS)
+		return;
+
+	t_arena *arena = zone->arena;
+	t_zone **bucket = &arena->zone_index[zone->type][zone->index_bin];
+	if (zone->index_prev)
+		zone->index_prev->index_next = zone->index_next;
+	else
+		*bucket = zone->index_next;
+	if (zone->index_next)
+		zone->index_next->index_prev = zone->index_prev;
+	if (!*bucket)
+		arena->zone_map[zone->type] &= ~(1UL << zone->index_bin);
+	zone->index_bin = FREE_BINS;
+}
+
+void zone_index_update(t_zone *zone) {
+	size_t bin = FREE_BINS;
+
+	if (zone->free_map)
+		bin = 63 - __builtin_clzl(zone->free_map);
+
+	if (bin == zone->index_bin)
+		return;
+	zone_index_remove(zone);
+	if (bin == FREE_BINS)
+		return;
+
+	t_arena *arena = zone->arena;
+	t_zone **bucket = &arena->zone_index[zone->type][bin];
+	zone->index_bin = bin;
+	zone->index_prev = NULL;
+	zone->index_next = *bucket;
+	if (*bucket)
+		(*bucket)->index_prev = zone;
+	*bucket = zone;
+	arena->zone_map[zone->type] |= 1UL << bin;
+}
+
+t_zone *find_zone_for_size(t_arena *arena, size_t size) {
+	return find_zone_of_type(arena, GET_ZONE_TYPE(size), size);
+}
+
+t_zone *find_zone_of_type(t_arena *arena, zone_type_t type, size_t size) {
+	size_t bin = free_bin_index(size);
+
+	// Tightest bucket first: its head fits whenever the bin is exact
+	t_zone *zone = arena->zone_index[type][bin];
+	if (zone && find_free_block(zone, size))
+		return zone;
+
+	// Any zone whose highest free bin is above the request fits
+	uint64_t larger = arena->zone_map[type] & ~((2UL << bin) - 1);
+	if (larger)
+		return arena->zone_index[type][__builtin_ctzl(larger)];
+
+	// Before mapping a new zone, give the rest of the tightest bucket a try
+	for (; zone; zone = zone->index_next)
+		if (find_free_block(zone, size))
+			return zone;
 
 	size_t zone_size;
 	switch (type) {
-	case ZONE_TINY:
-		zone_size = TINY_ZONE_SIZE;
-		break;
 	case ZONE_SMALL:
 		zone_size = SMALL_ZONE_SIZE;
 		break;
 	case ZONE_LARGE:
 	default:
-		zone_size = ALIGN(size + sizeof(t_zone) + BLOCK_METADATA_SIZE);
+		zone_size = ALIGN(size + ZONE_HEADER_SIZE + BLOCK_METADATA_SIZE);
 	}
 
-	return create_zone(type, zone_size);
+	return create_zone(arena, type, zone_size);
 }
 
 t_zone *find_zone_containing(void *ptr) {
-	t_zone *zone = g_zones;
-
-	while (zone) {
-		if (ptr >= zone->start &&
-		    ptr < (void *)((char *)zone->start + zone->total_size))
-			return zone;
-		zone = zone->next;
-	}
-
-	return NULL;
+	// Every zone is registered in the page map when it is created
+	return pagemap_lookup(ptr);
 }
@@ -2,59 +2,138 @@
 #include "malloc_internal.h"
 
 // Init global variables
-t_zone *g_zones = NULL;
-pthread_mutex_t g_malloc_mutex = PTHREAD_MUTEX_INITIALIZER;
+t_arena g_arenas[MAX_ARENAS];
+size_t g_arena_count = 0;
 
-void *malloc(size_t size) {
+/**
+ * Serve a TINY request from the thread cache or the arena's slabs
+ */
+static void *tiny_malloc(size_t size) {
+	void *result = tcache_get(ALIGN(size));
+
+	if (!result) {
+		t_arena *arena = get_thread_arena();
+		arena_lock(arena);
+		remote_free_drain(arena);
+		result = slab_alloc(arena, size);
+		arena_unlock(arena);
+	}
+	return result;
+}
+
+void *alloc_memory(size_t size, t_bool zero) {
 	void *result = NULL;
 
 	if (size > (SIZE_MAX - BLOCK_METADATA_SIZE - MALLOC_ALIGNMENT))
 		return NULL;
 
 	init_malloc_system();
-	pthread_mutex_lock(&g_malloc_mutex);
 	if (size == 0)
 		size = 1;
-	logger("malloc", NULL, size);
 
-	if (size >= get_max_allocation_size()) {
-		pthread_mutex_unlock(&g_malloc_mutex);
-		return NULL;
-	} // Too large for this system
+	if (size >= get_max_allocation_size())
+		return NULL; // Too large for this system
+	if (size <= TINY_MAX_SIZE) {
+		result = tiny_malloc(size);
+		if (result && zero)
+			block_memset(result, 0, size);
+		return result;
+	}
 	size_t needed_size = CALC_NEEDED_SIZE(size);
-	if (needed_size < size) {
-		pthread_mutex_unlock(&g_malloc_mutex);
-		return NULL;
-	} // Integer overflow check
+	if (needed_size < size)
+		return NULL; // Integer overflow check
 
 	needed_size = ALIGN(needed_size);
-	if (needed_size < size) {
-		pthread_mutex_unlock(&g_malloc_mutex);
-		return NULL;
-	} // Another overflow check
+	if (needed_size < size)
+		return NULL; // Another overflow check
+
+	// Fast path: reuse a block from the thread cache without locking
+	result = tcache_get(needed_size);
+	if (result) {
+		if (zero)
+			block_memset(result, 0, size);
+		return result;
+	}
 
-	t_zone *zone = find_zone_for_size(needed_size);
+	t_arena *arena = get_thread_arena();
+	arena_lock(arena);
+	remote_free_drain(arena);
+	t_zone *zone = find_zone_for_size(arena, needed_size);
 	if (!zone) {
-		pthread_mutex_unlock(&g_malloc_mutex);
+		arena_unlock(arena);
 		return NULL;
 	}
 
 	t_block *block = find_free_block(zone, needed_size);
 	if (!block) {
-		// defragment_memory();
+		// defragment_memory(arena);
 		block = find_free_block(zone, needed_size);
 		if (!block) {
-			pthread_mutex_unlock(&g_malloc_mutex);
+			arena_unlock(arena);
 			return NULL;
 		}
 	}
-	block = split_block(block, needed_size);
-	block->is_free = false;
-	zone->used_blocks++;
-	zone->free_space -= needed_size;
-
-	result = (void *)((char *)block + BLOCK_METADATA_SIZE);
-	logger("malloc", result, size);
-	pthread_mutex_unlock(&g_malloc_mutex);
+	size_t state = block_take(zone, block, needed_size);
+	arena_unlock(arena);
+
+	if (zero)
+		block_zero(block, size, state);
+	return BLOCK_DATA(block);
+}
+
+void *malloc(size_t size) {
+	void *result = alloc_memory(size, false);
+	trace_event(TRACE_MALLOC, result, size, 0);
 	return result;
 }
+
+/**
+ * Carve count SMALL or LARGE blocks of needed_size bytes, as many as fit out
+ * of each free block found
+ * Caller must hold the arena lock
+ */
+static size_t carve_blocks(t_arena *arena, size_t needed_size, size_t count,
+                           void **ptrs) {
+	size_t done = 0;
+
+	while (done < count) {
+		t_zone *zone = find_zone_for_size(arena, needed_size);
+		t_block *block = zone ? find_free_block(zone, needed_size) : NULL;
+		if (!block)
+			break;
+		done +=
+		  block_carve(zone, block, needed_size, count - done, ptrs + done);
+	}
+	return done;
+}
+
+size_t malloc_batch(size_t size, size_t count, void **ptrs) {
+	size_t done = 0;
+
+	if (size > (SIZE_MAX - BLOCK_METADATA_SIZE - MALLOC_ALIGNMENT))
+		return 0;
+	init_malloc_system();
+	if (size == 0)
+		size = 1;
+	if (size >= get_max_allocation_size())
+		return 0;
+
+	// Same size class as alloc_memory(), TINY or not
+	size_t needed_size = ALIGN(size);
+	while (done < count && (ptrs[done] = tcache_get(needed_size)))
+		done++;
+	if (done < count) {
+		t_arena *arena = get_thread_arena();
+		arena_lock(arena);
+		remote_free_drain(arena);
+		if (size <= TINY_MAX_SIZE)
+			while (done < count && (ptrs[done] = slab_alloc(arena, size)))
+				done++;
+		else
+			done += carve_blocks(arena, needed_size, count - done, ptrs + done);
+		arena_unlock(arena);
+	}
+	for (size_t i = 0; i < done; i++)
+		trace_event(TRACE_MALLOC_BATCH, ptrs[i], size, 0);
+	return done;
+}
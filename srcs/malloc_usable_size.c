@@ -0,0 +1,19 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+
+size_t malloc_usable_size(void *ptr) {
+	if (!ptr)
+		return 0;
+
+	t_zone *zone = find_zone_containing(ptr);
+	if (!zone)
+		return 0;
+	// TINY objects own their whole size class
+	if (zone->type == ZONE_TINY)
+		return slab_owns(zone, ptr) ? zone->slab_size : 0;
+
+	// Blocks own their data area, which may exceed the request: a remainder
+	// too small to split off, or the rest of a LARGE mapping's last page
+	t_block *block = (t_block *)((char *)ptr - BLOCK_METADATA_SIZE);
+	return verify_block(block) ? BLOCK_SIZE(block) : 0;
+}
@@ -0,0 +1,69 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+
+t_options g_options = {
+  .coalesce_budget = DEFAULT_COALESCE_BUDGET,
+  .frag_threshold = DEFAULT_FRAG_THRESHOLD,
+  .large_cache_max = DEFAULT_LARGE_CACHE_MAX,
+  .large_cache_decay = DEFAULT_LARGE_CACHE_DECAY,
+  .huge_pages = DEFAULT_HUGE_PAGES,
+  .purge_threshold = DEFAULT_PURGE_THRESHOLD,
+  .retain_zones = DEFAULT_RETAIN_ZONES,
+  .background_thread = DEFAULT_BACKGROUND_THREAD,
+  .decay_time = DEFAULT_DECAY_TIME,
+};
+
+int ft_mallopt(int param, int value) {
+	if (value < 0)
+		return 0;
+
+	switch (param) {
+	case FT_M_COALESCE_BUDGET:
+		__atomic_store_n(&g_options.coalesce_budget, value, __ATOMIC_RELAXED);
+		return 1;
+	case FT_M_FRAG_THRESHOLD:
+		__atomic_store_n(&g_options.frag_threshold, value, __ATOMIC_RELAXED);
+		return 1;
+	case FT_M_LARGE_CACHE_MAX:
+		__atomic_store_n(&g_options.large_cache_max, value, __ATOMIC_RELAXED);
+		return 1;
+	case FT_M_LARGE_CACHE_DECAY:
+		__atomic_store_n(&g_options.large_cache_decay, value, __ATOMIC_RELAXED);
+		return 1;
+	case FT_M_HUGE_PAGES:
+		if (value > 1)
+			return 0;
+		__atomic_store_n(&g_options.huge_pages, value, __ATOMIC_RELAXED);
+		return 1;
+	case FT_M_PURGE_THRESHOLD:
+		__atomic_store_n(&g_options.purge_threshold, value, __ATOMIC_RELAXED);
+		return 1;
+	case FT_M_RETAIN_ZONES:
+		__atomic_store_n(&g_options.retain_zones, value, __ATOMIC_RELAXED);
+		return 1;
+	case FT_M_BACKGROUND_THREAD:
+		if (value > 1)
+			return 0;
+		__atomic_store_n(&g_options.background_thread, value, __ATOMIC_RELAXED);
+		return 1;
+	case FT_M_DECAY_TIME:
+		__atomic_store_n(&g_options.decay_time, value, __ATOMIC_RELAXED);
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+void ft_malloc_maintenance(void) {
+	init_malloc_system();
+	for (size_t i = 0; i < g_arena_count; i++) {
+		t_arena *arena = &g_arenas[i];
+
+		arena_lock(arena);
+		remote_free_drain(arena);
+		defragment_memory(arena);
+		purge_arena(arena, SIZE_MAX);
+		arena_unlock(arena);
+	}
+	large_cache_decay();
+}
@@ -0,0 +1,128 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+#include <errno.h>
+
+#define IS_POWER_OF_TWO(value) ((value) && !((value) & ((value) - 1)))
+
+/**
+ * Serve a SMALL request from a free block whose front is cut off up to the
+ * first alignment boundary, the front staying free for other requests
+ */
+static void *small_aligned(size_t alignment, size_t needed_size) {
+	size_t padded =
+	  needed_size + alignment + BLOCK_METADATA_SIZE + MALLOC_ALIGNMENT;
+	t_arena *arena = get_thread_arena();
+
+	arena_lock(arena);
+	remote_free_drain(arena);
+	t_zone *zone = find_zone_of_type(arena, ZONE_SMALL, padded);
+	t_block *block = zone ? find_free_block(zone, padded) : NULL;
+	if (!block) {
+		arena_unlock(arena);
+		return NULL;
+	}
+	block = block_align(zone, block, alignment);
+	block_take(zone, block, needed_size);
+	arena_unlock(arena);
+	return BLOCK_DATA(block);
+}
+
+/**
+ * Serve a request from a LARGE zone laid out so that its block is aligned,
+ * rather than from a block over-allocated by the alignment
+ */
+static void *large_aligned(size_t alignment, size_t needed_size) {
+	t_arena *arena = get_thread_arena();
+
+	arena_lock(arena);
+	t_zone *zone = create_aligned_zone(arena, needed_size, alignment);
+	if (!zone) {
+		arena_unlock(arena);
+		return NULL;
+	}
+	block_take(zone, zone->blocks, needed_size);
+	arena_unlock(arena);
+	return BLOCK_DATA(zone->blocks);
+}
+
+void *alloc_aligned(size_t alignment, size_t size) {
+	if (alignment <= MALLOC_ALIGNMENT)
+		return alloc_memory(size, false);
+	if (size > SIZE_MAX - alignment - BLOCK_METADATA_SIZE - MALLOC_ALIGNMENT)
+		return NULL;
+
+	init_malloc_system();
+	if (size == 0)
+		size = 1;
+	if (size >= get_max_allocation_size())
+		return NULL; // Too large for this system
+
+	// Slab objects start on every power of two dividing their size
+	size_t rounded = (size + alignment - 1) & ~(alignment - 1);
+	if (rounded <= TINY_MAX_SIZE)
+		return alloc_memory(rounded, false);
+
+	// SMALL blocks stay larger than any TINY object, as the thread caches
+	// tell them apart by their size
+	size_t needed_size = ALIGN(size);
+	if (needed_size <= TINY_MAX_SIZE)
+		needed_size = TINY_MAX_SIZE + MALLOC_ALIGNMENT;
+	if (needed_size > SMALL_MAX_SIZE || alignment > (size_t)PAGE_SIZE)
+		return large_aligned(alignment, needed_size);
+	// Padding a block up to the next boundary leaves the block carved after
+	// it aligned as well, cheaper than a front for small alignments
+	if (alignment <= TINY_MAX_SIZE)
+		needed_size =
+		  ((needed_size + BLOCK_METADATA_SIZE + alignment - 1) & ~(alignment - 1)) -
+		  BLOCK_METADATA_SIZE;
+	return small_aligned(alignment, needed_size);
+}
+
+/**
+ * Allocate through alloc_aligned(), traced as op
+ */
+static void *traced_aligned(t_trace_op op, size_t alignment, size_t size) {
+	void *result = alloc_aligned(alignment, size);
+	trace_event(op, result, size, alignment);
+	return result;
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size) {
+	if (!IS_POWER_OF_TWO(alignment) || alignment % sizeof(void *))
+		return EINVAL;
+
+	void *result = traced_aligned(TRACE_POSIX_MEMALIGN, alignment, size);
+	if (!result)
+		return ENOMEM;
+	*memptr = result;
+	return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size) {
+	if (!IS_POWER_OF_TWO(alignment))
+		return NULL;
+	return traced_aligned(TRACE_ALIGNED_ALLOC, alignment, size);
+}
+
+void *memalign(size_t alignment, size_t size) {
+	// Like glibc, an alignment that is not a power of two is rounded up
+	if (!IS_POWER_OF_TWO(alignment) && alignment > MALLOC_ALIGNMENT) {
+		if (alignment > SIZE_MAX / 2 + 1)
+			return NULL;
+		alignment = 1UL << (64 - __builtin_clzl(alignment));
+	}
+	return traced_aligned(TRACE_MEMALIGN, alignment, size);
+}
+
+void *valloc(size_t size) {
+	return traced_aligned(TRACE_VALLOC, PAGE_SIZE, size);
+}
+
+void *pvalloc(size_t size) {
+	size_t rounded = PAGE_ALIGN(size);
+
+	if (rounded < size)
+		return NULL;
+	return traced_aligned(TRACE_PVALLOC, PAGE_SIZE,
+	                      rounded ? rounded : (size_t)PAGE_SIZE);
+}
@@ -1,67 +1,112 @@
 #include "malloc.h"
 #include "malloc_internal.h"
 
-void *realloc(void *ptr, size_t size) {
+/**
+ * Resize a block like realloc(), untraced: the blocks it allocates and
+ * frees are part of the traced realloc()
+ */
+static void *realloc_memory(void *ptr, size_t size) {
 	if (ptr == NULL)
-		return malloc(size);
+		return alloc_memory(size, false);
 
 	if (size == 0) {
-		free(ptr);
+		free_memory(ptr);
 		return NULL;
 	}
 
-	pthread_mutex_lock(&g_malloc_mutex);
-
 	t_zone *zone = find_zone_containing(ptr);
-	if (!zone) {
-		pthread_mutex_unlock(&g_malloc_mutex);
+	if (!zone)
 		return NULL;
+
+	t_arena *arena = zone->arena;
+	arena_lock(arena);
+
+	// TINY objects stay in place while the new size fits their size class
+	if (zone->type == ZONE_TINY) {
+		size_t old_size = zone->slab_size;
+		t_bool valid = slab_owns(zone, ptr);
+
+		arena_unlock(arena);
+		if (!valid)
+			return NULL;
+		if (size <= old_size)
+			return ptr;
+		void *new_ptr = alloc_memory(size, false);
+		if (new_ptr) {
+			block_memcpy(new_ptr, ptr, old_size);
+			free_memory(ptr);
+		}
+		return new_ptr;
 	}
 
 	t_block *block = (t_block *)((char *)ptr - BLOCK_METADATA_SIZE);
 
 	if (!verify_block(block)) {
-		pthread_mutex_unlock(&g_malloc_mutex);
+		arena_unlock(arena);
 		return NULL;
 	}
 
 	size_t needed_size = CALC_NEEDED_SIZE(size);
+	// Rounding a size close to SIZE_MAX up wraps around to a tiny one
+	if (needed_size < size) {
+		arena_unlock(arena);
+		return NULL;
+	}
+
+	// LARGE blocks own their mapping: resize it instead of copying the data
+	if (zone->type == ZONE_LARGE) {
+		t_zone *resized = zone_resize(zone, needed_size);
+		if (resized) {
+			arena_unlock(arena);
+			return BLOCK_DATA(resized->blocks);
+		}
+	}
 
 	// Case 1: Current block is big enough
-	if (block->size >= needed_size) {
+	if (BLOCK_SIZE(block) >= needed_size) {
 		// We can split the block if it's significantly larger
-		if (block->size > needed_size + BLOCK_METADATA_SIZE + MALLOC_ALIGNMENT) {
+		if (BLOCK_SIZE(block) >
+		    needed_size + BLOCK_METADATA_SIZE + MALLOC_ALIGNMENT) {
 			block = split_block(block, needed_size);
 		}
-		pthread_mutex_unlock(&g_malloc_mutex);
+		arena_unlock(arena);
 		return ptr;
 	}
 
 	// Case 2: Try to merge with next block if it's free
-	if (block->next && block->next->is_free &&
-	    block->size + BLOCK_METADATA_SIZE + block->next->size >= needed_size) {
+	t_block *next = block_next(zone, block);
+	if (next && BLOCK_IS_FREE(next) &&
+	    BLOCK_SIZE(block) + BLOCK_METADATA_SIZE + BLOCK_SIZE(next) >=
+	      needed_size) {
 
 		// Merge with next block
-		block->size += BLOCK_METADATA_SIZE + block->next->size;
-		block->next = block->next->next;
-		if (block->next)
-			block->next->prev = block;
+		free_bin_remove(zone, next);
+		block_absorb_next(zone, block);
 
 		// Split if needed
-		if (block->size > needed_size + BLOCK_METADATA_SIZE + MALLOC_ALIGNMENT) {
+		if (BLOCK_SIZE(block) >
+		    needed_size + BLOCK_METADATA_SIZE + MALLOC_ALIGNMENT) {
 			block = split_block(block, needed_size);
 		}
 
-		pthread_mutex_unlock(&g_malloc_mutex);
+		arena_unlock(arena);
 		return ptr;
 	}
 
 	// Case 3: Need to allocate new block
-	pthread_mutex_unlock(&g_malloc_mutex);
-	void *new_ptr = malloc(size);
+	size_t old_size = BLOCK_SIZE(block);
+	arena_unlock(arena);
+	void *new_ptr = alloc_memory(size, false);
 	if (new_ptr) {
-		block_memcpy(new_ptr, ptr, block->size < size ? block->size : size);
-		free(ptr);
+		block_memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+		free_memory(ptr);
 	}
 	return new_ptr;
 }
+
+void *realloc(void *ptr, size_t size) {
+	void *result = realloc_memory(ptr, size);
+
+	trace_event(TRACE_REALLOC, result, size, (uintptr_t)ptr);
+	return result;
+}
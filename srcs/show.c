@@ -1,66 +1,192 @@
 #include "malloc.h"
 #include "malloc_internal.h"
 
-static void ft_putnbr(size_t n, int base, char *charset, int fd) {
+/* Reports are written through one buffer, so that two threads printing at
+ * the same time do not mix their lines */
+static pthread_mutex_t g_output_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char g_output[SHOW_BUFFER_SIZE];
+static size_t g_output_length = 0;
+
+static void output_flush(void) {
+	for (size_t done = 0; done < g_output_length;) {
+		ssize_t written = write(1, g_output + done, g_output_length - done);
+		if (written <= 0)
+			break;
+		done += written;
+	}
+	g_output_length = 0;
+}
+
+static void output_char(char c) {
+	if (g_output_length == SHOW_BUFFER_SIZE)
+		output_flush();
+	g_output[g_output_length++] = c;
+}
+
+static void ft_putnbr(size_t n, int base, char *charset) {
 	char buffer[32];
 	int i = 0;
 
 	if (n == 0) {
-		write(fd, "0", 1);
+		output_char('0');
 	} else {
 		while (n) {
 			buffer[i++] = charset[n % base];
 			n /= base;
 		}
 		while (i > 0)
-			write(fd, &buffer[--i], 1);
+			output_char(buffer[--i]);
 	}
 }
 
-static void ft_putstr(char *str, int fd) {
+static void ft_putstr(char *str) {
 	while (*str)
-		write(fd, str++, 1);
+		output_char(*str++);
+}
+
+static void ft_putaddr(void *addr) {
+	ft_putstr("0x");
+	ft_putnbr((size_t)addr, 16, "0123456789ABCDEF");
+}
+
+static void lock_arenas(void) {
+	for (size_t i = 0; i < g_arena_count; i++) {
+		arena_lock(&g_arenas[i]);
+		remote_free_drain(&g_arenas[i]);
+	}
+}
+
+static void unlock_arenas(void) {
+	for (size_t i = 0; i < g_arena_count; i++)
+		arena_unlock(&g_arenas[i]);
+}
+
+static void print_range(void *start, size_t size) {
+	ft_putaddr(start);
+	ft_putstr(" - ");
+	ft_putaddr((char *)start + size - 1);
+	ft_putstr(" : ");
+	ft_putnbr(size, 10, "0123456789");
+	ft_putstr(" bytes\n");
+}
+
+/**
+ * Check whether a slab object is handed out to the program
+ * Objects parked in a thread cache or remote list still look allocated in
+ * the bitmap
+ */
+static t_bool slab_object_used(t_zone *zone, size_t index) {
+	if (zone->slab_bitmap[index / 64] & (1ULL << (index % 64)))
+		return false;
+	return !slab_is_parked(zone, index);
+}
+
+/*
+ * What show_alloc_mem() prints about a zone, then about each of its
+ * allocated blocks, so that it can be gathered first and printed later
+ */
+typedef struct s_show_entry {
+	void *start;      /* Zone, or user data of the block */
+	size_t size;      /* Size of the block, 0 for a zone */
+	zone_type_t type; /* Type of the zone */
+} t_show_entry;
+
+typedef void (*t_show_fn)(t_show_entry *entry, void *arg);
+
+/*
+ * Entries of the arenas copied by show_alloc_mem_snapshot(), in a mapping
+ * of its own rather than in the heap being reported
+ */
+typedef struct s_snapshot {
+	t_show_entry *entries;
+	size_t count;
+	size_t capacity;
+} t_snapshot;
+
+static void walk_zone(t_zone *zone, t_show_fn fn, void *arg) {
+	t_show_entry entry = {zone->start, 0, zone->type};
+
+	fn(&entry, arg);
+	entry.size = zone->slab_size;
+	for (size_t i = 0; i < zone->slab_capacity; i++) {
+		if (slab_object_used(zone, i)) {
+			entry.start = zone->slab_objects + i * zone->slab_size;
+			fn(&entry, arg);
+		}
+	}
+
+	for (t_block *block = zone->blocks; block;
+	     block = block_next(zone, block)) {
+		if (!BLOCK_IS_FREE(block) && block->magic == MAGIC_NUMBER) {
+			entry.start = BLOCK_DATA(block);
+			entry.size = BLOCK_SIZE(block);
+			fn(&entry, arg);
+		}
+	}
 }
 
-static void ft_putaddr(void *addr, int fd) {
-	ft_putstr("0x", fd);
-	ft_putnbr((size_t)addr, 16, "0123456789ABCDEF", fd);
+static void print_entry(t_show_entry *entry, void *arg) {
+	size_t *total_bytes = arg;
+
+	if (entry->size) {
+		print_range(entry->start, entry->size);
+		*total_bytes += entry->size;
+		return;
+	}
+	if (entry->type == ZONE_TINY)
+		ft_putstr("TINY : ");
+	else if (entry->type == ZONE_SMALL)
+		ft_putstr("SMALL : ");
+	else
+		ft_putstr("LARGE : ");
+	ft_putaddr(entry->start);
+	ft_putstr("\n");
 }
 
 static void print_mem() {
 	size_t total_bytes = 0;
-	t_zone *zone = g_zones;
-
-	ft_putstr("\n===== MEMORY BLOCK SUMMARY =====\n", 1);
-	while (zone) {
-		if (zone->type == ZONE_TINY)
-			ft_putstr("TINY : ", 1);
-		else if (zone->type == ZONE_SMALL)
-			ft_putstr("SMALL : ", 1);
-		else
-			ft_putstr("LARGE : ", 1);
-		ft_putaddr(zone->start, 1);
-		ft_putstr("\n", 1);
-
-		t_block *block = zone->blocks;
-		while (block) {
-			if (!block->is_free) {
-				void *start = &(block->padding), *end = (char *)start + block->size - 1;
-				ft_putaddr(start, 1);
-				ft_putstr(" - ", 1);
-				ft_putaddr(end, 1);
-				ft_putstr(" : ", 1);
-				ft_putnbr(block->size, 10, "0123456789", 1);
-				ft_putstr(" bytes\n", 1);
-				total_bytes += block->size;
-			}
-			block = block->next;
-		}
-		zone = zone->next;
+
+	ft_putstr("\n===== MEMORY BLOCK SUMMARY =====\n");
+	for (size_t i = 0; i < g_arena_count; i++)
+		for (t_zone *zone = g_arenas[i].zones; zone; zone = zone->next)
+			walk_zone(zone, print_entry, &total_bytes);
+	ft_putstr("Total : ");
+	ft_putnbr(total_bytes, 10, "0123456789");
+	ft_putstr(" bytes\n");
+}
+
+static void snapshot_entry(t_show_entry *entry, void *arg) {
+	t_snapshot *snapshot = arg;
+
+	if (snapshot->count < snapshot->capacity)
+		snapshot->entries[snapshot->count++] = *entry;
+}
+
+/**
+ * Copy the entries of an arena, which must be locked. Every zone has at
+ * most one entry per used block, thread caches included, plus its own
+ */
+static t_bool snapshot_arena(t_arena *arena, t_snapshot *snapshot) {
+	size_t capacity = 0;
+
+	for (t_zone *zone = arena->zones; zone; zone = zone->next)
+		capacity += 1 + zone->used_blocks;
+	snapshot->count = 0;
+	snapshot->capacity = PAGE_ALIGN(capacity * sizeof(t_show_entry)) /
+	                     sizeof(t_show_entry);
+	snapshot->entries = NULL;
+	if (!capacity)
+		return true;
+	snapshot->entries =
+	  mmap(NULL, snapshot->capacity * sizeof(t_show_entry),
+	       PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (snapshot->entries == MAP_FAILED) {
+		snapshot->entries = NULL;
+		return false;
 	}
-	ft_putstr("Total : ", 1);
-	ft_putnbr(total_bytes, 10, "0123456789", 1);
-	ft_putstr(" bytes\n", 1);
+	for (t_zone *zone = arena->zones; zone; zone = zone->next)
+		walk_zone(zone, snapshot_entry, snapshot);
+	return true;
 }
 
 static void print_hex_dump(void *addr, size_t size) {
@@ -70,138 +196,301 @@ static void print_hex_dump(void *addr, size_t size) {
 		// New line every 16 bytes
 		if (i % 16 == 0) {
 			if (i > 0)
-				ft_putstr("\n", 1);
-			ft_putaddr((void *)(data + i), 1);
-			ft_putstr(": ", 1);
+				ft_putstr("\n");
+			ft_putaddr((void *)(data + i));
+			ft_putstr(": ");
 		}
 
 		// Print byte in hex
 		if (data[i] < 16)
-			ft_putstr("0", 1); // Leading zero for single digit
-		ft_putnbr(data[i], 16, "0123456789abcdef", 1);
-		ft_putstr(" ", 1);
+			ft_putstr("0"); // Leading zero for single digit
+		ft_putnbr(data[i], 16, "0123456789abcdef");
+		ft_putstr(" ");
 
 		// Print ASCII representation after 16 bytes
 		if ((i + 1) % 16 == 0 || i == size - 1) {
 			// Padding for incomplete line
 			for (size_t j = 0; j < 15 - (i % 16); j++)
-				ft_putstr("   ", 1);
+				ft_putstr("   ");
 
-			ft_putstr(" | ", 1);
+			ft_putstr(" | ");
 
 			// Print ASCII chars (printable only)
 			for (size_t j = i - (i % 16); j <= i; j++) {
 				if (data[j] >= 32 && data[j] <= 126)
-					write(1, &data[j], 1);
+					output_char(data[j]);
 				else
-					ft_putstr(".", 1);
+					ft_putstr(".");
 			}
 		}
 	}
-	ft_putstr("\n", 1);
+	ft_putstr("\n");
+}
+
+typedef struct s_mem_stats {
+	size_t total_bytes;
+	size_t total_zones;
+	size_t total_used;
+	size_t total_free;
+	size_t total_blocks;
+	size_t total_free_blocks;
+	size_t total_max_free_blocks;
+	size_t total_cached_blocks;
+} t_mem_stats;
+
+static void print_block_detail(char *label, void *addr, void *data,
+                               size_t size) {
+	ft_putstr(label);
+	ft_putaddr(addr);
+	ft_putstr(":\n");
+	ft_putstr("  Size: ");
+	ft_putnbr(size, 10, "0123456789");
+	ft_putstr(" bytes\n");
+	if (addr != data) {
+		ft_putstr("  Magic: 0x");
+		ft_putnbr(((t_block *)addr)->magic, 16, "0123456789ABCDEF");
+		ft_putstr("\n");
+	}
+	ft_putstr("  Data preview:\n");
+	print_hex_dump(data, size < 64 ? size : 64);
+	ft_putstr("\n");
+}
+
+/**
+ * Add the free block counters a zone maintains to the totals
+ */
+static void count_free(t_mem_stats *stats, size_t blocks, size_t bytes,
+                       size_t largest) {
+	stats->total_blocks += blocks;
+	stats->total_free_blocks += blocks;
+	stats->total_free += bytes;
+	if (largest > stats->total_max_free_blocks)
+		stats->total_max_free_blocks = largest;
+}
+
+static void detail_blocks(t_zone *zone, t_mem_stats *stats) {
+	count_free(stats, zone->free_count, zone->total_free, zone->largest_free);
+	for (t_block *block = zone->blocks; block;
+	     block = block_next(zone, block)) {
+		if (BLOCK_IS_FREE(block))
+			continue;
+		++stats->total_blocks;
+		if (block->magic == TCACHE_MAGIC || block->magic == REMOTE_MAGIC) {
+			++stats->total_cached_blocks;
+		} else {
+			stats->total_used += BLOCK_SIZE(block);
+			print_block_detail("Block at ", block, BLOCK_DATA(block),
+			                   BLOCK_SIZE(block));
+		}
+	}
+}
+
+static void detail_slab(t_zone *zone, t_mem_stats *stats) {
+	size_t free_objects = zone->slab_capacity - zone->used_blocks;
+
+	count_free(stats, free_objects, zone->free_space,
+	           free_objects ? zone->slab_size : 0);
+	stats->total_blocks += zone->used_blocks;
+
+	for (size_t i = 0; i < zone->slab_capacity; i++) {
+		void *object = zone->slab_objects + i * zone->slab_size;
+
+		if (zone->slab_bitmap[i / 64] & (1ULL << (i % 64)))
+			continue;
+		if (slab_is_parked(zone, i)) {
+			++stats->total_cached_blocks;
+		} else {
+			stats->total_used += zone->slab_size;
+			print_block_detail("Object at ", object, object, zone->slab_size);
+		}
+	}
+}
+
+static void print_arenas(void) {
+	ft_putstr("\n===== ARENA STATISTICS =====\n");
+	for (size_t i = 0; i < g_arena_count; i++) {
+		t_arena *arena = &g_arenas[i];
+		size_t zones = 0;
+
+		for (t_zone *zone = arena->zones; zone; zone = zone->next)
+			++zones;
+		ft_putstr("Arena ");
+		ft_putnbr(arena->index, 10, "0123456789");
+		ft_putstr(": ");
+		ft_putnbr(zones, 10, "0123456789");
+		ft_putstr(" zones, ");
+		ft_putnbr(arena->lock_count, 10, "0123456789");
+		ft_putstr(" lock acquisitions, ");
+		ft_putnbr(arena->contended, 10, "0123456789");
+		ft_putstr(" contended\n  Pages: ");
+		ft_putnbr(arena->dirty_pages, 10, "0123456789");
+		ft_putstr(" dirty, ");
+		ft_putnbr(arena->purged_pages, 10, "0123456789");
+		ft_putstr(" purged; empty zones: ");
+		ft_putnbr(arena->empty_zones, 10, "0123456789");
+		ft_putstr(" retained, ");
+		ft_putnbr(arena->released_zones, 10, "0123456789");
+		ft_putstr(" unmapped\n");
+	}
+}
+
+static void print_large_cache(void) {
+	t_large_cache_stats cache;
+
+	large_cache_get_stats(&cache);
+	ft_putstr("\n===== LARGE CACHE STATISTICS =====\n");
+	ft_putstr("Cached regions: ");
+	ft_putnbr(cache.regions, 10, "0123456789");
+	ft_putstr(" (");
+	ft_putnbr(cache.bytes, 10, "0123456789");
+	ft_putstr(" bytes)\nHits: ");
+	ft_putnbr(cache.hits, 10, "0123456789");
+	ft_putstr(", misses: ");
+	ft_putnbr(cache.misses, 10, "0123456789");
+	ft_putstr(", evictions: ");
+	ft_putnbr(cache.evictions, 10, "0123456789");
+	if (cache.hits + cache.misses > 0) {
+		ft_putstr("\nHit rate: ");
+		ft_putnbr(cache.hits * 100 / (cache.hits + cache.misses), 10,
+		          "0123456789");
+		ft_putstr("%");
+	}
+	ft_putstr("\n");
 }
 
 void show_alloc_mem(void) {
-	pthread_mutex_lock(&g_malloc_mutex);
+	pthread_mutex_lock(&g_output_mutex);
+	lock_arenas();
 	print_mem();
-	pthread_mutex_unlock(&g_malloc_mutex);
+	unlock_arenas();
+	output_flush();
+	pthread_mutex_unlock(&g_output_mutex);
+}
+
+void show_alloc_mem_snapshot(void) {
+	size_t total_bytes = 0;
+	t_snapshot snapshot;
+
+	pthread_mutex_lock(&g_output_mutex);
+	ft_putstr("\n===== MEMORY BLOCK SUMMARY =====\n");
+	for (size_t i = 0; i < g_arena_count; i++) {
+		t_arena *arena = &g_arenas[i];
+
+		arena_lock(arena);
+		remote_free_drain(arena);
+		if (!snapshot_arena(arena, &snapshot)) {
+			// No memory for a copy: print this arena the slow way
+			for (t_zone *zone = arena->zones; zone; zone = zone->next)
+				walk_zone(zone, print_entry, &total_bytes);
+			arena_unlock(arena);
+			continue;
+		}
+		// Formatting and writing no longer hold up the arena
+		arena_unlock(arena);
+		for (size_t j = 0; j < snapshot.count; j++)
+			print_entry(&snapshot.entries[j], &total_bytes);
+		if (snapshot.entries)
+			munmap(snapshot.entries, snapshot.capacity * sizeof(t_show_entry));
+	}
+	ft_putstr("Total : ");
+	ft_putnbr(total_bytes, 10, "0123456789");
+	ft_putstr(" bytes\n");
+	output_flush();
+	pthread_mutex_unlock(&g_output_mutex);
 }
 
 void show_alloc_mem_ex(void) {
-	pthread_mutex_lock(&g_malloc_mutex);
+	t_bool has_zones = false;
 
-	if (!g_zones) {
-		ft_putstr("\n===== NO MEMORY ALLOCATIONS =====\n", 1);
-		pthread_mutex_unlock(&g_malloc_mutex);
+	pthread_mutex_lock(&g_output_mutex);
+	lock_arenas();
+	for (size_t i = 0; i < g_arena_count; i++)
+		if (g_arenas[i].zones)
+			has_zones = true;
+	if (!has_zones) {
+		ft_putstr("\n===== NO MEMORY ALLOCATIONS =====\n");
+		unlock_arenas();
+		output_flush();
+		pthread_mutex_unlock(&g_output_mutex);
 		return;
 	}
 
-	size_t total_bytes = 0, total_zones = 0, total_used = 0, total_free = 0,
-	       total_blocks = 0, total_free_blocks = 0, total_max_free_blocks = 0;
-	t_zone *zone = g_zones;
-
-	ft_putstr("\n===== MEMORY BLOCK DETAIL =====\n", 1);
-	while (zone) {
-		++total_zones;
-		total_bytes += zone->total_size;
-
-		t_block *block = zone->blocks;
-		ft_putstr("Zone at ", 1);
-		ft_putaddr(zone, 1);
-		ft_putstr(" (", 1);
-		if (zone->type == ZONE_TINY)
-			ft_putstr("TINY", 1);
-		else if (zone->type == ZONE_SMALL)
-			ft_putstr("SMALL", 1);
-		else
-			ft_putstr("LARGE", 1);
-		ft_putstr("): blocks at ", 1);
-		ft_putaddr(zone->blocks, 1);
-		ft_putstr("\n", 1);
-		while (block) {
-			++total_blocks;
-			if (block->is_free) {
-				total_free += block->size;
-				++total_free_blocks;
-				if (block->size > total_max_free_blocks)
-					total_max_free_blocks = block->size;
+	t_mem_stats stats = {0};
+
+	ft_putstr("\n===== MEMORY BLOCK DETAIL =====\n");
+	for (size_t i = 0; i < g_arena_count; i++) {
+		t_zone *zone = g_arenas[i].zones;
+		while (zone) {
+			++stats.total_zones;
+			stats.total_bytes += zone->total_size;
+
+			ft_putstr("Zone at ");
+			ft_putaddr(zone);
+			if (zone->type == ZONE_TINY) {
+				ft_putstr(" (TINY slab of ");
+				ft_putnbr(zone->slab_size, 10, "0123456789");
+				ft_putstr(" bytes): objects at ");
+				ft_putaddr(zone->slab_objects);
+				ft_putstr("\n");
+				detail_slab(zone, &stats);
 			} else {
-				size_t dump_size = block->size < 64 ? block->size : 64;
-
-				total_used += block->size;
-				ft_putstr("Block at ", 1);
-				ft_putaddr(block, 1);
-				ft_putstr(":\n", 1);
-				ft_putstr("  Size: ", 1);
-				ft_putnbr(block->size, 10, "0123456789", 1);
-				ft_putstr(" bytes\n", 1);
-				ft_putstr("  Magic: 0x", 1);
-				ft_putnbr(block->magic, 16, "0123456789ABCDEF", 1);
-				ft_putstr("\n", 1);
-				ft_putstr("  Data preview:\n", 1);
-				print_hex_dump(&(block->padding), dump_size);
-				ft_putstr("\n", 1);
+				ft_putstr(zone->type == ZONE_SMALL ? " (SMALL" : " (LARGE");
+				ft_putstr("): blocks at ");
+				ft_putaddr(zone->blocks);
+				ft_putstr("\n  Free: ");
+				ft_putnbr(zone->free_count, 10, "0123456789");
+				ft_putstr(" blocks, ");
+				ft_putnbr(zone->total_free, 10, "0123456789");
+				ft_putstr(" bytes, largest ");
+				ft_putnbr(zone->largest_free, 10, "0123456789");
+				ft_putstr(" bytes\n");
+				detail_blocks(zone, &stats);
 			}
-			block = block->next;
+			zone = zone->next;
 		}
-		zone = zone->next;
-	}
-
-	ft_putstr("\n===== MEMORY ALLOCATION STATISTICS =====\n", 1);
-	ft_putstr("Total zones: ", 1);
-	ft_putnbr(total_zones, 10, "0123456789", 1);
-	ft_putstr("\nTotal memory: ", 1);
-	ft_putnbr(total_bytes, 10, "0123456789", 1);
-	ft_putstr(" bytes\n", 1);
-	ft_putstr("Memory usage: ", 1);
-	ft_putnbr(total_used, 10, "0123456789", 1);
-	ft_putstr(" bytes used, ", 1);
-	ft_putnbr(total_free, 10, "0123456789", 1);
-	ft_putstr(" bytes free\n", 1);
-	if (total_bytes > 0) {
-		ft_putstr("Usage ratio: ", 1);
-		ft_putnbr((total_used * 100) / total_bytes, 10, "0123456789", 1);
-		ft_putstr("% used, ", 1);
-		ft_putnbr((total_free * 100) / total_bytes, 10, "0123456789", 1);
-		ft_putstr("% free\n", 1);
-	}
-
-	ft_putstr("\n===== MEMORY FRAGMENGATION STATISTICS =====\n", 1);
-	ft_putstr("Fragmentation metrics:\n", 1);
-	ft_putstr("  Total blocks: ", 1);
-	ft_putnbr(total_blocks, 10, "0123456789", 1);
-	ft_putstr("\n  Free blocks: ", 1);
-	ft_putnbr(total_free_blocks, 10, "0123456789", 1);
-	ft_putstr("\n  Fragmentation: ", 1);
-	if (total_blocks > 0) {
-		ft_putnbr((total_free_blocks * 100) / total_blocks, 10, "0123456789", 1);
-		ft_putstr("%\n", 1);
-	}
-	ft_putstr("  Largest free block: ", 1);
-	ft_putnbr(total_max_free_blocks, 10, "0123456789", 1);
-	ft_putstr(" bytes\n", 1);
+	}
+
+	ft_putstr("\n===== MEMORY ALLOCATION STATISTICS =====\n");
+	ft_putstr("Total zones: ");
+	ft_putnbr(stats.total_zones, 10, "0123456789");
+	ft_putstr("\nTotal memory: ");
+	ft_putnbr(stats.total_bytes, 10, "0123456789");
+	ft_putstr(" bytes\n");
+	ft_putstr("Memory usage: ");
+	ft_putnbr(stats.total_used, 10, "0123456789");
+	ft_putstr(" bytes used, ");
+	ft_putnbr(stats.total_free, 10, "0123456789");
+	ft_putstr(" bytes free\n");
+	if (stats.total_bytes > 0) {
+		ft_putstr("Usage ratio: ");
+		ft_putnbr((stats.total_used * 100) / stats.total_bytes, 10, "0123456789");
+		ft_putstr("% used, ");
+		ft_putnbr((stats.total_free * 100) / stats.total_bytes, 10, "0123456789");
+		ft_putstr("% free\n");
+	}
+
+	ft_putstr("\n===== MEMORY FRAGMENGATION STATISTICS =====\n");
+	ft_putstr("Fragmentation metrics:\n");
+	ft_putstr("  Total blocks: ");
+	ft_putnbr(stats.total_blocks, 10, "0123456789");
+	ft_putstr("\n  Free blocks: ");
+	ft_putnbr(stats.total_free_blocks, 10, "0123456789");
+	ft_putstr("\n  Cached or queued blocks: ");
+	ft_putnbr(stats.total_cached_blocks, 10, "0123456789");
+	ft_putstr("\n  Fragmentation: ");
+	if (stats.total_blocks > 0) {
+		ft_putnbr((stats.total_free_blocks * 100) / stats.total_blocks, 10, "0123456789");
+		ft_putstr("%\n");
+	}
+	ft_putstr("  Largest free block: ");
+	ft_putnbr(stats.total_max_free_blocks, 10, "0123456789");
+	ft_putstr(" bytes\n");
 
+	print_arenas();
+	print_large_cache();
 	print_mem();
 
-	pthread_mutex_unlock(&g_malloc_mutex);
+	unlock_arenas();
+	output_flush();
+	pthread_mutex_unlock(&g_output_mutex);
 }
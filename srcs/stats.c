@@ -0,0 +1,258 @@
+#include "malloc.h"
+#include "malloc_internal.h"
+
+/* Longest JSON document ft_malloc_stats_json() produces, with room to spare */
+#define STATS_JSON_MAX 2048
+
+/*
+ * Output of ft_malloc_stats_json(): the length counts what did not fit,
+ * like snprintf()
+ */
+typedef struct s_json {
+	char *buffer;
+	size_t size;
+	size_t length;
+} t_json;
+
+/**
+ * Turn the counters of one zone type, summed over the arenas, into what the
+ * program sees
+ */
+static void zone_stats_export(t_malloc_zone_stats *out, t_zone_stats *in) {
+	out->zones = in->zones;
+	out->mapped = in->mapped;
+	out->metadata = in->metadata;
+	out->free = in->free;
+	out->free_blocks = in->free_blocks;
+	out->fragmentation = in->fragmented;
+	out->active = in->mapped - in->metadata - in->free;
+}
+
+static void zone_stats_add(t_malloc_zone_stats *total,
+                           t_malloc_zone_stats *zone) {
+	total->zones += zone->zones;
+	total->mapped += zone->mapped;
+	total->active += zone->active;
+	total->free += zone->free;
+	total->free_blocks += zone->free_blocks;
+	total->metadata += zone->metadata;
+	total->fragmentation += zone->fragmentation;
+}
+
+t_malloc_stats ft_malloc_stats(void) {
+	t_zone_stats sums[ZONE_TYPES] = {{0}};
+	t_malloc_stats stats = {0};
+	t_large_cache_stats cache;
+
+	// Each arena is only locked for as long as it takes to copy its counters
+	for (size_t i = 0; i < g_arena_count; i++) {
+		t_arena *arena = &g_arenas[i];
+
+		arena_lock(arena);
+		for (size_t type = 0; type < ZONE_TYPES; type++) {
+			sums[type].zones += arena->stats[type].zones;
+			sums[type].mapped += arena->stats[type].mapped;
+			sums[type].metadata += arena->stats[type].metadata;
+			sums[type].free += arena->stats[type].free;
+			sums[type].free_blocks += arena->stats[type].free_blocks;
+			sums[type].fragmented += arena->stats[type].fragmented;
+		}
+		stats.dirty += arena->dirty_pages * PAGE_SIZE;
+		stats.purged += arena->purged_pages * PAGE_SIZE;
+		arena_unlock(arena);
+	}
+	zone_stats_export(&stats.tiny, &sums[ZONE_TINY]);
+	zone_stats_export(&stats.small, &sums[ZONE_SMALL]);
+	zone_stats_export(&stats.large, &sums[ZONE_LARGE]);
+	zone_stats_add(&stats.total, &stats.tiny);
+	zone_stats_add(&stats.total, &stats.small);
+	zone_stats_add(&stats.total, &stats.large);
+	stats.arenas = g_arena_count;
+	large_cache_get_stats(&cache);
+	stats.large_cache = cache.bytes;
+	return stats;
+}
+
+struct mallinfo2 mallinfo2(void) {
+	t_malloc_stats stats = ft_malloc_stats();
+	struct mallinfo2 info = {0};
+
+	// TINY and SMALL zones play the part of the main heap, LARGE zones the
+	// part of the chunks mapped on their own
+	info.arena = stats.tiny.mapped + stats.small.mapped;
+	info.ordblks = stats.tiny.free_blocks + stats.small.free_blocks;
+	info.hblks = stats.large.zones;
+	info.hblkhd = stats.large.mapped;
+	info.uordblks = stats.tiny.active + stats.small.active;
+	info.fordblks = stats.tiny.free + stats.small.free;
+	info.keepcost = stats.dirty;
+	return info;
+}
+
+static void json_put(t_json *json, const char *str) {
+	for (; *str; str++, json->length++)
+		if (json->length < json->size)
+			json->buffer[json->length] = *str;
+}
+
+static void json_put_number(t_json *json, size_t n) {
+	char digits[24];
+	size_t i = sizeof(digits) - 1;
+
+	digits[i] = '\0';
+	do {
+		digits[--i] = '0' + n % 10;
+		n /= 10;
+	} while (n);
+	json_put(json, digits + i);
+}
+
+static void json_put_field(t_json *json, const char *name, size_t value,
+                           t_bool last) {
+	json_put(json, "\"");
+	json_put(json, name);
+	json_put(json, "\":");
+	json_put_number(json, value);
+	if (!last)
+		json_put(json, ",");
+}
+
+static void json_put_zone(t_json *json, const char *name,
+                          t_malloc_zone_stats *zone, t_bool last) {
+	json_put(json, "\"");
+	json_put(json, name);
+	json_put(json, "\":{");
+	json_put_field(json, "zones", zone->zones, false);
+	json_put_field(json, "mapped", zone->mapped, false);
+	json_put_field(json, "active", zone->active, false);
+	json_put_field(json, "free", zone->free, false);
+	json_put_field(json, "free_blocks", zone->free_blocks, false);
+	json_put_field(json, "metadata", zone->metadata, false);
+	json_put_field(json, "fragmentation", zone->fragmentation, true);
+	json_put(json, last ? "}" : "},");
+}
+
+size_t ft_malloc_stats_json(char *buffer, size_t size) {
+	t_malloc_stats stats = ft_malloc_stats();
+	t_json json = {buffer, size, 0};
+
+	json_put(&json, "{");
+	json_put_field(&json, "arenas", stats.arenas, false);
+	json_put_field(&json, "large_cache", stats.large_cache, false);
+	json_put_field(&json, "dirty", stats.dirty, false);
+	json_put_field(&json, "purged", stats.purged, false);
+	json_put(&json, "\"zones\":{");
+	json_put_zone(&json, "tiny", &stats.tiny, false);
+	json_put_zone(&json, "small", &stats.small, false);
+	json_put_zone(&json, "large", &stats.large, false);
+	json_put_zone(&json, "total", &stats.total, true);
+	json_put(&json, "}}\n");
+	if (size)
+		buffer[json.length < size ? json.length : size - 1] = '\0';
+	return json.length;
+}
+
+int ft_malloc_stats_json_fd(int fd) {
+	char buffer[STATS_JSON_MAX];
+	size_t length = ft_malloc_stats_json(buffer, sizeof(buffer));
+
+	if (length >= sizeof(buffer))
+		return -1;
+	for (size_t done = 0; done < length;) {
+		ssize_t written = write(fd, buffer + done, length - done);
+		if (written < 0)
+			return -1;
+		done += written;
+	}
+	return 0;
+}
+
+/**
+ * Count the free objects of a TINY slab from its bitmap, and add them to the
+ * totals of its arena
+ * Returns the number of zone counters that disagree with the bitmap
+ */
+static int slab_check(t_zone *zone, t_zone_stats *sums) {
+	size_t free_objects = 0;
+
+	for (size_t i = 0; i < (zone->slab_capacity + 63) / 64; i++)
+		free_objects += __builtin_popcountll(zone->slab_bitmap[i]);
+
+	sums->metadata += zone->total_size - zone->slab_capacity * zone->slab_size;
+	sums->free += free_objects * zone->slab_size;
+	sums->free_blocks += free_objects;
+	if (zone->used_blocks)
+		sums->fragmented += free_objects * zone->slab_size;
+	return (free_objects != zone->slab_capacity - zone->used_blocks) +
+	       (free_objects * zone->slab_size != zone->free_space);
+}
+
+/**
+ * Walk the blocks and the free bins of a SMALL or LARGE zone, and add what
+ * they hold to the totals of its arena
+ * Returns the number of zone counters that disagree with the walk
+ */
+static int blocks_check(t_zone *zone, t_zone_stats *sums) {
+	size_t blocks = 0;
+	size_t free_count = 0;
+	size_t total_free = 0;
+	size_t largest_free = 0;
+	size_t binned = 0;
+
+	for (t_block *block = zone->blocks; block;
+	     block = block_next(zone, block)) {
+		blocks++;
+		if (!BLOCK_IS_FREE(block))
+			continue;
+		free_count++;
+		total_free += BLOCK_SIZE(block);
+		if (BLOCK_SIZE(block) > largest_free)
+			largest_free = BLOCK_SIZE(block);
+	}
+	for (size_t i = 0; i < FREE_BINS; i++)
+		for (t_block *block = zone->free_bins[i]; block;
+		     block = FREE_LINKS(block)->next)
+			binned++;
+
+	sums->metadata += (char *)zone->blocks - (char *)zone->start +
+	                  blocks * BLOCK_METADATA_SIZE;
+	sums->free += total_free;
+	sums->free_blocks += free_count;
+	sums->fragmented += total_free - largest_free;
+	return (free_count != zone->free_count) + (binned != free_count) +
+	       (total_free != zone->total_free) +
+	       (largest_free != zone->largest_free) +
+	       (blocks != zone->used_blocks + free_count);
+}
+
+static int zone_stats_check(t_zone_stats *counters, t_zone_stats *sums) {
+	return (counters->zones != sums->zones) +
+	       (counters->mapped != sums->mapped) +
+	       (counters->metadata != sums->metadata) +
+	       (counters->free != sums->free) +
+	       (counters->free_blocks != sums->free_blocks) +
+	       (counters->fragmented != sums->fragmented);
+}
+
+int ft_malloc_check(void) {
+	int errors = 0;
+
+	for (size_t i = 0; i < g_arena_count; i++) {
+		t_arena *arena = &g_arenas[i];
+		t_zone_stats sums[ZONE_TYPES] = {{0}};
+
+		arena_lock(arena);
+		for (t_zone *zone = arena->zones; zone; zone = zone->next) {
+			sums[zone->type].zones++;
+			sums[zone->type].mapped += zone->total_size;
+			if (zone->type == ZONE_TINY)
+				errors += slab_check(zone, &sums[zone->type]);
+			else
+				errors += blocks_check(zone, &sums[zone->type]);
+		}
+		for (size_t type = 0; type < ZONE_TYPES; type++)
+			errors += zone_stats_check(&arena->stats[type], &sums[type]);
+		arena_unlock(arena);
+	}
+	return errors;
+}
@@ -0,0 +1,291 @@
+#include "malloc_internal.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+
+/* Prefix of the trace file names of debug builds without FT_MALLOC_TRACE */
+#define TRACE_DEFAULT_PREFIX "ft_malloc"
+
+/**
+ * Records of one thread: only the owning thread appends to them, and only
+ * the thread holding g_trace_mutex writes them out
+ */
+typedef struct s_trace_ring {
+	struct s_trace_ring *next; /* Rings ever mapped, never unmapped */
+	t_bool owned;              /* Bound to a live thread */
+	uint32_t thread;           /* Kernel thread id of the owner */
+	size_t head;               /* Records appended by the owner */
+	size_t tail;               /* Records written out */
+	t_trace_record records[TRACE_RING_RECORDS];
+} t_trace_ring;
+
+static __thread t_trace_ring *g_ring __attribute__((tls_model("initial-exec")));
+/* Set while the tracer itself runs, so that what it allocates is not traced */
+static __thread t_bool g_tracing __attribute__((tls_model("initial-exec")));
+static t_trace_ring *g_rings = NULL;
+/* Held while rings are written out, and across fork() */
+static pthread_mutex_t g_trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_trace_key;
+static int g_trace_fd = -1;
+static t_bool g_trace_failed = false;
+static t_bool g_flusher_running = false;
+static t_bool g_trace_exiting = false;
+/* Known once the first operation of the process is traced */
+static t_bool g_trace_disabled = false;
+
+static char *trace_put_str(char *dst, char *end, const char *str) {
+	while (*str && dst < end)
+		*dst++ = *str++;
+	return dst;
+}
+
+static char *trace_put_number(char *dst, char *end, size_t n) {
+	char digits[24];
+	size_t i = sizeof(digits);
+
+	do {
+		digits[--i] = '0' + n % 10;
+		n /= 10;
+	} while (n);
+	while (i < sizeof(digits) && dst < end)
+		*dst++ = digits[i++];
+	return dst;
+}
+
+static t_bool trace_write(const void *data, size_t length) {
+	for (size_t done = 0; done < length;) {
+		ssize_t written = write(g_trace_fd, (const char *)data + done,
+		                        length - done);
+		if (written <= 0)
+			return false;
+		done += written;
+	}
+	return true;
+}
+
+/**
+ * Create <prefix>.<pid>.trace, prefix being FT_MALLOC_TRACE or
+ * TRACE_DEFAULT_PREFIX, so that forked and executed processes get their own
+ * file
+ * Caller must hold g_trace_mutex
+ */
+static void trace_open(void) {
+	const char *prefix = getenv("FT_MALLOC_TRACE");
+	char path[PATH_MAX];
+	char *end = path + sizeof(path) - 1;
+	char *pos = path;
+
+	if (!prefix || !*prefix)
+		prefix = TRACE_DEFAULT_PREFIX;
+	pos = trace_put_str(pos, end, prefix);
+	pos = trace_put_str(pos, end, ".");
+	pos = trace_put_number(pos, end, getpid());
+	pos = trace_put_str(pos, end, ".trace");
+	*pos = '\0';
+
+	t_trace_header header = {.magic = TRACE_MAGIC,
+	                         .version = TRACE_VERSION,
+	                         .record_size = sizeof(t_trace_record)};
+	g_trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (g_trace_fd >= 0 && !trace_write(&header, sizeof(header))) {
+		close(g_trace_fd);
+		g_trace_fd = -1;
+	}
+	g_trace_failed = (g_trace_fd < 0);
+}
+
+/**
+ * Write out what a ring holds; without a trace file the records are dropped
+ * Caller must hold g_trace_mutex
+ */
+static void trace_ring_write(t_trace_ring *ring) {
+	size_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	size_t tail = ring->tail;
+
+	if (head == tail)
+		return;
+	if (g_trace_fd < 0 && !g_trace_failed)
+		trace_open();
+	while (tail < head && g_trace_fd >= 0) {
+		size_t start = tail % TRACE_RING_RECORDS;
+		size_t count = head - tail;
+
+		if (count > TRACE_RING_RECORDS - start)
+			count = TRACE_RING_RECORDS - start;
+		if (!trace_write(&ring->records[start], count * sizeof(t_trace_record))) {
+			close(g_trace_fd);
+			g_trace_fd = -1;
+			g_trace_failed = true;
+		}
+		tail += count;
+	}
+	__atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+}
+
+static void trace_ring_flush(t_trace_ring *ring) {
+	pthread_mutex_lock(&g_trace_mutex);
+	trace_ring_write(ring);
+	pthread_mutex_unlock(&g_trace_mutex);
+}
+
+static void trace_flush_all(void) {
+	pthread_mutex_lock(&g_trace_mutex);
+	for (t_trace_ring *ring = __atomic_load_n(&g_rings, __ATOMIC_ACQUIRE); ring;
+	     ring = ring->next)
+		trace_ring_write(ring);
+	pthread_mutex_unlock(&g_trace_mutex);
+}
+
+static void *trace_flusher_main(void *arg) {
+	struct timespec tick = {.tv_sec = TRACE_FLUSH_INTERVAL_MS / 1000,
+	                        .tv_nsec = (TRACE_FLUSH_INTERVAL_MS % 1000) * 1000000};
+
+	(void)arg;
+	while (true) {
+		nanosleep(&tick, NULL);
+		trace_flush_all();
+	}
+	return NULL;
+}
+
+static void trace_flusher_start(void) {
+	t_bool expected = false;
+
+	if (__atomic_load_n(&g_flusher_running, __ATOMIC_RELAXED) ||
+	    !__atomic_compare_exchange_n(&g_flusher_running, &expected, true, false,
+	                                 __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		return;
+
+	pthread_attr_t attr;
+	pthread_t thread;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&thread, &attr, trace_flusher_main, NULL) != 0)
+		__atomic_store_n(&g_flusher_running, false, __ATOMIC_RELEASE);
+	pthread_attr_destroy(&attr);
+}
+
+/**
+ * Write out the ring of an exiting thread and leave it to the next thread
+ */
+static void trace_ring_release(void *arg) {
+	t_trace_ring *ring = arg;
+
+	trace_ring_flush(ring);
+	g_ring = NULL;
+	__atomic_store_n(&ring->owned, false, __ATOMIC_RELEASE);
+}
+
+/* A fork() never happens while rings are written out */
+static void trace_prefork(void) { pthread_mutex_lock(&g_trace_mutex); }
+
+static void trace_postfork_parent(void) {
+	pthread_mutex_unlock(&g_trace_mutex);
+}
+
+/**
+ * The parent writes out what the rings held at the fork(); the child starts
+ * from empty rings, its own file and, on its next operation, its own
+ * flusher thread
+ */
+static void trace_postfork_child(void) {
+	pthread_mutex_init(&g_trace_mutex, NULL);
+	for (t_trace_ring *ring = g_rings; ring; ring = ring->next) {
+		ring->tail = ring->head;
+		ring->owned = false;
+	}
+	g_ring = NULL;
+	if (g_trace_fd >= 0)
+		close(g_trace_fd);
+	g_trace_fd = -1;
+	g_trace_failed = false;
+	g_flusher_running = false;
+}
+
+static void trace_setup(void) {
+	const char *prefix = getenv("FT_MALLOC_TRACE");
+
+	if (!DEBUG_MALLOC && (!prefix || !*prefix)) {
+		__atomic_store_n(&g_trace_disabled, true, __ATOMIC_RELAXED);
+		return;
+	}
+	pthread_key_create(&g_trace_key, trace_ring_release);
+	pthread_atfork(trace_prefork, trace_postfork_parent, trace_postfork_child);
+}
+
+/**
+ * Bind a ring to the calling thread: one left by an exited thread, or a
+ * new one
+ */
+static t_trace_ring *trace_ring_acquire(void) {
+	t_trace_ring *ring;
+
+	g_tracing = true;
+	pthread_once(&g_trace_once, trace_setup);
+	if (__atomic_load_n(&g_trace_disabled, __ATOMIC_RELAXED)) {
+		g_tracing = false;
+		return NULL;
+	}
+	for (ring = __atomic_load_n(&g_rings, __ATOMIC_ACQUIRE); ring;
+	     ring = ring->next) {
+		t_bool expected = false;
+		if (__atomic_compare_exchange_n(&ring->owned, &expected, true, false,
+		                                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			break;
+	}
+	if (!ring) {
+		ring = mmap(NULL, sizeof(t_trace_ring), PROT_READ | PROT_WRITE,
+		            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ring == MAP_FAILED) {
+			g_tracing = false;
+			return NULL;
+		}
+		ring->owned = true;
+		ring->next = __atomic_load_n(&g_rings, __ATOMIC_RELAXED);
+		while (!__atomic_compare_exchange_n(&g_rings, &ring->next, ring, true,
+		                                    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+			;
+	}
+	ring->thread = (uint32_t)syscall(SYS_gettid);
+	pthread_setspecific(g_trace_key, ring);
+	g_ring = ring;
+	trace_flusher_start();
+	g_tracing = false;
+	return ring;
+}
+
+/* Whatever is traced after this runs is written out right away */
+__attribute__((destructor)) static void trace_exit(void) {
+	__atomic_store_n(&g_trace_exiting, true, __ATOMIC_RELAXED);
+	trace_flush_all();
+}
+
+void trace_event(t_trace_op op, void *ptr, size_t size, size_t arg) {
+	t_trace_ring *ring = g_ring;
+
+	if (!ring) {
+		if (__atomic_load_n(&g_trace_disabled, __ATOMIC_RELAXED) || g_tracing ||
+		    !(ring = trace_ring_acquire()))
+			return;
+	}
+	// A full ring is written out by its owner rather than dropping records
+	if (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) ==
+	    TRACE_RING_RECORDS)
+		trace_ring_flush(ring);
+
+	t_trace_record *record = &ring->records[ring->head % TRACE_RING_RECORDS];
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	record->time = now.tv_sec * 1000000000ULL + now.tv_nsec;
+	record->ptr = (uintptr_t)ptr;
+	record->size = size;
+	record->arg = arg;
+	record->thread = ring->thread;
+	record->op = op;
+	record->reserved = 0;
+	__atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+	if (__atomic_load_n(&g_trace_exiting, __ATOMIC_RELAXED))
+		trace_ring_flush(ring);
+}
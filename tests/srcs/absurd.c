@@ -25,6 +25,13 @@ void test_extreme_large_allocations() {
 	ft_printf("  SIZE_MAX allocation: %s\n",
 	          ptr ? "succeeded (unexpected)" : "failed as expected");
 	free(ptr);
+
+	// Growing a SMALL block to SIZE_MAX must fail and leave it untouched
+	ptr = malloc(512);
+	void *grown = realloc(ptr, SIZE_MAX);
+	assert(grown == NULL && malloc_usable_size(ptr) >= 512);
+	ft_printf("  SIZE_MAX reallocation: failed as expected\n");
+	free(ptr);
 #pragma GCC diagnostic pop
 
 	// Try SIZE_MAX/2 - likely to fail but tests large allocation handling
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
 
@@ -351,6 +352,210 @@ void test_memory_pressure() {
 	ft_printf("PASSED: Memory pressure test\n");
 }
 
+// ======== 7. Tuning Tests ========
+
+void test_tuning() {
+	ft_printf("Testing ft_mallopt and deferred maintenance...\n");
+
+	assert(ft_mallopt(FT_M_COALESCE_BUDGET, -1) == 0);
+	assert(ft_mallopt(-1, 0) == 0);
+
+	// Defer every coalescing pass to the explicit maintenance call
+	assert(ft_mallopt(FT_M_COALESCE_BUDGET, 0) == 1);
+	assert(ft_mallopt(FT_M_FRAG_THRESHOLD, 0) == 1);
+
+	void *blocks[200];
+	for (int i = 0; i < 200; i++) {
+		blocks[i] = malloc(200 + i);
+		assert(blocks[i] != NULL);
+		memset(blocks[i], i & 0xFF, 200 + i);
+	}
+	for (int i = 0; i < 200; i += 2)
+		free(blocks[i]);
+	ft_malloc_maintenance();
+	for (int i = 1; i < 200; i += 2) {
+		unsigned char *data = blocks[i];
+		for (int j = 0; j < 200 + i; j++)
+			assert(data[j] == (i & 0xFF));
+		free(blocks[i]);
+	}
+
+	assert(ft_mallopt(FT_M_COALESCE_BUDGET, 64) == 1);
+	assert(ft_mallopt(FT_M_FRAG_THRESHOLD, 150) == 1);
+
+	// Huge page backed zones behave like any other zone
+	assert(ft_mallopt(FT_M_HUGE_PAGES, 2) == 0);
+	assert(ft_mallopt(FT_M_HUGE_PAGES, 1) == 1);
+	char *small = malloc(1000);
+	char *large = malloc(3 * 1024 * 1024);
+	assert(small != NULL && large != NULL);
+	memset(small, 0x5A, 1000);
+	memset(large, 0xA5, 3 * 1024 * 1024);
+	large = realloc(large, 5 * 1024 * 1024);
+	assert(large != NULL);
+	for (int i = 0; i < 3 * 1024 * 1024; i += 4096)
+		assert((unsigned char)large[i] == 0xA5);
+	assert((unsigned char)small[999] == 0x5A);
+	free(small);
+	free(large);
+	assert(ft_mallopt(FT_M_HUGE_PAGES, 0) == 1);
+
+	// Purge on every free and unmap every empty zone, live data survives
+	assert(ft_mallopt(FT_M_PURGE_THRESHOLD, 0) == 1);
+	assert(ft_mallopt(FT_M_RETAIN_ZONES, 0) == 1);
+	for (int round = 0; round < 3; round++) {
+		for (int i = 0; i < 200; i++) {
+			blocks[i] = malloc(i % 2 ? 64 : 900);
+			assert(blocks[i] != NULL);
+			memset(blocks[i], i & 0xFF, i % 2 ? 64 : 900);
+		}
+		for (int i = 0; i < 200; i++)
+			if (i % 10)
+				free(blocks[i]);
+		for (int i = 0; i < 200; i += 10) {
+			unsigned char *data = blocks[i];
+			for (int j = 0; j < 900; j++)
+				assert(data[j] == (i & 0xFF));
+			free(blocks[i]);
+		}
+	}
+	assert(ft_mallopt(FT_M_PURGE_THRESHOLD, 512) == 1);
+	assert(ft_mallopt(FT_M_RETAIN_ZONES, 2) == 1);
+
+	// Background purger racing the foreground, then across fork()
+	assert(ft_mallopt(FT_M_BACKGROUND_THREAD, 2) == 0);
+	assert(ft_mallopt(FT_M_DECAY_TIME, 20) == 1);
+	assert(ft_mallopt(FT_M_BACKGROUND_THREAD, 1) == 1);
+	for (int round = 0; round < 20; round++) {
+		for (int i = 0; i < 200; i++) {
+			blocks[i] = malloc(i % 2 ? 5000 : 700);
+			assert(blocks[i] != NULL);
+			memset(blocks[i], round, i % 2 ? 5000 : 700);
+		}
+		usleep(2000);
+		for (int i = 0; i < 200; i++) {
+			assert(((unsigned char *)blocks[i])[0] == round);
+			free(blocks[i]);
+		}
+	}
+	pid_t pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		for (int i = 0; i < 1000; i++)
+			free(malloc(4000 + i));
+		usleep(50000);
+		_exit(0);
+	}
+	int status;
+	assert(waitpid(pid, &status, 0) == pid);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	assert(ft_mallopt(FT_M_BACKGROUND_THREAD, 0) == 1);
+	assert(ft_mallopt(FT_M_DECAY_TIME, 10000) == 1);
+	ft_printf("PASSED: Tuning test\n");
+}
+
+// ======== 8. Free Block Counter Tests ========
+
+#define COUNTER_BLOCKS 300
+#define COUNTER_OPS 20000
+
+void test_free_counters() {
+	ft_printf("Testing the free block counters against a heap walk...\n");
+
+	void *blocks[COUNTER_BLOCKS];
+	size_t sizes[COUNTER_BLOCKS];
+
+	// Splits: SMALL blocks of many sizes carved out of fresh zones
+	for (int i = 0; i < COUNTER_BLOCKS; i++) {
+		sizes[i] = 200 + (i * 37) % 800;
+		blocks[i] = malloc(sizes[i]);
+		assert(blocks[i] != NULL);
+	}
+	assert(ft_malloc_check() == 0);
+
+	// Isolated free blocks, more than the thread cache holds
+	for (int i = 0; i < COUNTER_BLOCKS; i += 2)
+		free(blocks[i]);
+	assert(ft_malloc_check() == 0);
+	assert(ft_malloc_stats().small.free_blocks > 0);
+
+	// Realloc in place: shrinking splits, growing absorbs the free neighbour
+	for (int i = 1; i < COUNTER_BLOCKS; i += 2) {
+		blocks[i] = realloc(blocks[i], sizes[i] / 2);
+		assert(blocks[i] != NULL);
+	}
+	assert(ft_malloc_check() == 0);
+	for (int i = 1; i < COUNTER_BLOCKS; i += 2) {
+		blocks[i] = realloc(blocks[i], sizes[i] + 300);
+		assert(blocks[i] != NULL);
+	}
+	assert(ft_malloc_check() == 0);
+
+	// A batch merging every block with its free neighbours
+	void *batch[COUNTER_BLOCKS / 2];
+	for (int i = 1; i < COUNTER_BLOCKS; i += 2)
+		batch[i / 2] = blocks[i];
+	free_batch(batch, COUNTER_BLOCKS / 2);
+	assert(ft_malloc_check() == 0);
+
+	// Aligned blocks leave a free block in front of them
+	for (int i = 0; i < COUNTER_BLOCKS; i++)
+		assert(posix_memalign(&blocks[i], 256, 300 + i) == 0);
+	assert(ft_malloc_check() == 0);
+	for (int i = 0; i < COUNTER_BLOCKS; i++)
+		free(blocks[i]);
+	assert(ft_malloc_check() == 0);
+
+	// Coalescing deferred to the maintenance call
+	assert(ft_mallopt(FT_M_COALESCE_BUDGET, 0) == 1);
+	for (int i = 0; i < COUNTER_BLOCKS; i++)
+		blocks[i] = malloc(sizes[i]);
+	for (int i = 0; i < COUNTER_BLOCKS; i++)
+		free(blocks[i]);
+	assert(ft_malloc_check() == 0);
+	ft_malloc_maintenance();
+	assert(ft_malloc_check() == 0);
+	assert(ft_mallopt(FT_M_COALESCE_BUDGET, 64) == 1);
+
+	// Random mix of every size class and operation
+	memset(blocks, 0, sizeof(blocks));
+	srand(42);
+	for (int op = 0; op < COUNTER_OPS; op++) {
+		int i = rand() % COUNTER_BLOCKS;
+		size_t size = rand() % 8 ? 1 + rand() % 1024 : 1 + rand() % 300000;
+
+		switch (rand() % 4) {
+		case 0:
+			free(blocks[i]);
+			blocks[i] = NULL;
+			break;
+		case 1:
+			blocks[i] = realloc(blocks[i], size);
+			assert(blocks[i] != NULL);
+			break;
+		case 2: {
+			void *pair[2] = {blocks[i], blocks[(i + 1) % COUNTER_BLOCKS]};
+			if (pair[0] == pair[1])
+				pair[1] = NULL;
+			free_batch(pair, 2);
+			blocks[i] = NULL;
+			blocks[(i + 1) % COUNTER_BLOCKS] = NULL;
+			break;
+		}
+		default:
+			free(blocks[i]);
+			blocks[i] = malloc(size);
+			assert(blocks[i] != NULL);
+		}
+		if (op % 500 == 0)
+			assert(ft_malloc_check() == 0);
+	}
+	for (int i = 0; i < COUNTER_BLOCKS; i++)
+		free(blocks[i]);
+	assert(ft_malloc_check() == 0);
+	ft_printf("PASSED: Free block counter test\n");
+}
+
 // ======== Main Test Function ========
 
 int main() {
@@ -361,6 +566,8 @@ int main() {
 	test_interoperability();
 	test_signal_handling();
 	test_memory_pressure();
+	test_tuning();
+	test_free_counters();
 
 	// Run long test last (it takes time)
 	test_long_running();
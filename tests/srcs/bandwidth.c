@@ -0,0 +1,156 @@
+#include "malloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int ft_printf(char *string, ...);
+
+/* Exported by the library, behind calloc() and realloc() */
+void *block_memcpy(void *dest, const void *src, size_t n);
+void *block_memset(void *s, int c, size_t n);
+
+#define MAX_SIZE (64L * 1024 * 1024)
+/* Bytes moved per size, so every size does the same amount of work */
+#define VOLUME (1024L * 1024 * 1024)
+/* The byte loop is slow enough to need less */
+#define BYTE_VOLUME (VOLUME / 16)
+/* Sizes and misalignments checked against libc */
+#define CHECK_SIZE 600
+#define CHECK_OFFSET 32
+
+typedef void *(*t_copy)(void *, const void *, size_t);
+typedef void *(*t_set)(void *, int, size_t);
+
+static char *g_src;
+static char *g_dest;
+
+static long long elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000000LL +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+// What block_memcpy() and block_memset() used to do
+static void *byte_memcpy(void *dest, const void *src, size_t n) {
+	char *d = (char *)dest;
+	const char *s = (const char *)src;
+
+	for (size_t i = 0; i < n; i++)
+		d[i] = s[i];
+	return dest;
+}
+
+static void *byte_memset(void *s, int c, size_t n) {
+	unsigned char *p = (unsigned char *)s;
+
+	for (size_t i = 0; i < n; i++)
+		p[i] = (unsigned char)c;
+	return s;
+}
+
+static int mb_per_s(long long bytes, long long ns) {
+	return ns ? (int)(bytes * 1000 / ns) : 0;
+}
+
+static int copy_rate(t_copy copy, long size, long volume) {
+	struct timespec start, end;
+	long iterations = volume / size ? volume / size : 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (long i = 0; i < iterations; i++) {
+		copy(g_dest, g_src, size);
+		__asm__ volatile("" ::: "memory");
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return mb_per_s(iterations * size, elapsed_ns(&start, &end));
+}
+
+static int set_rate(t_set set, long size, long volume) {
+	struct timespec start, end;
+	long iterations = volume / size ? volume / size : 1;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (long i = 0; i < iterations; i++) {
+		set(g_dest, (int)i, size);
+		__asm__ volatile("" ::: "memory");
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return mb_per_s(iterations * size, elapsed_ns(&start, &end));
+}
+
+// Every small size at every misalignment, then one streamed copy
+static void check_kernels(void) {
+	char *expected = malloc(CHECK_SIZE + 2 * CHECK_OFFSET);
+
+	for (int i = 0; i < MAX_SIZE; i++)
+		g_src[i] = (char)(i * 7 + i / 251);
+	for (int size = 0; size <= CHECK_SIZE; size++) {
+		for (int offset = 0; offset < CHECK_OFFSET; offset++) {
+			int src_offset = (offset * 5) % CHECK_OFFSET;
+
+			memset(g_dest, 'x', CHECK_SIZE + 2 * CHECK_OFFSET);
+			memset(expected, 'x', CHECK_SIZE + 2 * CHECK_OFFSET);
+			block_memcpy(g_dest + offset, g_src + src_offset, size);
+			memcpy(expected + offset, g_src + src_offset, size);
+			if (memcmp(g_dest, expected, CHECK_SIZE + 2 * CHECK_OFFSET)) {
+				ft_printf("block_memcpy failed: size %d offset %d\n", size,
+				          offset);
+				exit(1);
+			}
+			block_memset(g_dest + offset, offset, size);
+			memset(expected + offset, offset, size);
+			if (memcmp(g_dest, expected, CHECK_SIZE + 2 * CHECK_OFFSET)) {
+				ft_printf("block_memset failed: size %d offset %d\n", size,
+				          offset);
+				exit(1);
+			}
+		}
+	}
+	free(expected);
+
+	block_memcpy(g_dest + 3, g_src + 1, MAX_SIZE - 5);
+	if (memcmp(g_dest + 3, g_src + 1, MAX_SIZE - 5)) {
+		ft_printf("block_memcpy failed on %d MB\n", (int)(MAX_SIZE >> 20));
+		exit(1);
+	}
+	ft_printf("Kernels match libc on %d sizes x %d offsets and %d MB\n\n",
+	          CHECK_SIZE + 1, CHECK_OFFSET, (int)(MAX_SIZE >> 20));
+}
+
+static void print_size(long size) {
+	if (size >= 1024 * 1024)
+		ft_printf("  %d MB:", (int)(size >> 20));
+	else if (size >= 1024)
+		ft_printf("  %d KB:", (int)(size >> 10));
+	else
+		ft_printf("  %d B:", (int)size);
+}
+
+int main() {
+	ft_printf("=== BANDWIDTH BENCHMARK ===\n\n");
+	g_src = malloc(MAX_SIZE);
+	g_dest = malloc(MAX_SIZE);
+	if (!g_src || !g_dest)
+		return 1;
+	check_kernels();
+
+	ft_printf("memcpy, MB/s (block_memcpy / byte loop / libc):\n");
+	for (long size = 16; size <= MAX_SIZE; size *= 4) {
+		print_size(size);
+		ft_printf(" %d / %d / %d\n", copy_rate(block_memcpy, size, VOLUME),
+		          copy_rate(byte_memcpy, size, BYTE_VOLUME),
+		          copy_rate(memcpy, size, VOLUME));
+	}
+
+	ft_printf("\nmemset, MB/s (block_memset / byte loop / libc):\n");
+	for (long size = 16; size <= MAX_SIZE; size *= 4) {
+		print_size(size);
+		ft_printf(" %d / %d / %d\n", set_rate(block_memset, size, VOLUME),
+		          set_rate(byte_memset, size, BYTE_VOLUME),
+		          set_rate(memset, size, VOLUME));
+	}
+
+	free(g_src);
+	free(g_dest);
+	ft_printf("\nBandwidth benchmark completed!\n");
+	return 0;
+}
@@ -1,5 +1,7 @@
 #include "malloc.h"
 #include <assert.h>
+#include <errno.h>
+#include <stdint.h>
 #include <string.h>
 
 int ft_printf(char *string, ...);
@@ -42,6 +44,23 @@ void test_calloc() {
 
 	// Free memory
 	free(ptr);
+
+	// Memory dirtied then freed comes back cleared, whatever its size
+	static const size_t sizes[] = {24, 700, 5000, 300000, 3000000};
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (int round = 0; round < 3; round++) {
+			unsigned char *dirty = malloc(sizes[i]);
+			assert(dirty != NULL);
+			memset(dirty, 0xFF, sizes[i]);
+			free(dirty);
+			unsigned char *clean = calloc(1, sizes[i]);
+			assert(clean != NULL);
+			for (size_t j = 0; j < sizes[i]; j++)
+				assert(clean[j] == 0);
+			memset(clean, 0xEE, sizes[i]);
+			free(clean);
+		}
+	}
 	ft_printf("PASSED: Calloc initialization\n");
 }
 
@@ -113,6 +132,176 @@ void test_allocation_sizes() {
 	ft_printf("PASSED: Various allocation sizes\n");
 }
 
+// Test the aligned allocation family
+void test_aligned() {
+	ft_printf("Testing aligned allocations...\n");
+
+	static const size_t sizes[] = {1, 24, 100, 129, 700, 1024, 5000, 300000};
+	enum { SIZES = sizeof(sizes) / sizeof(sizes[0]) };
+	void *ptrs[SIZES * 18];
+	int count = 0;
+
+	// Every alignment from 32 B to 2 MB, the blocks kept alive together
+	for (size_t alignment = 32; alignment <= 2 * 1024 * 1024; alignment *= 2) {
+		for (int i = 0; i < SIZES; i++) {
+			char *ptr = aligned_alloc(alignment, sizes[i]);
+			assert(ptr != NULL);
+			assert((uintptr_t)ptr % alignment == 0);
+			memset(ptr, (int)i, sizes[i]);
+			ptrs[count++] = ptr;
+		}
+	}
+	// Contents survive the neighbouring allocations, then a realloc
+	for (int i = 0; i < count; i++) {
+		unsigned char *ptr = ptrs[i];
+		size_t size = sizes[i % SIZES];
+		assert(ptr[0] == i % SIZES && ptr[size - 1] == i % SIZES);
+		if (i % 3 == 0) {
+			ptr = realloc(ptr, size * 2);
+			assert(ptr != NULL);
+			assert(ptr[0] == i % SIZES && ptr[size - 1] == i % SIZES);
+			ptrs[i] = ptr;
+		}
+	}
+	// Free every other block first, so that fronts and rests merge back
+	for (int i = 0; i < count; i += 2)
+		free(ptrs[i]);
+	for (int i = 1; i < count; i += 2)
+		free(ptrs[i]);
+
+	void *ptr = NULL;
+	assert(posix_memalign(&ptr, 64, 100) == 0);
+	assert(ptr != NULL && (uintptr_t)ptr % 64 == 0);
+	free(ptr);
+	assert(posix_memalign(&ptr, 24, 100) == EINVAL);
+	assert(posix_memalign(&ptr, 4, 100) == EINVAL);
+	assert(aligned_alloc(48, 100) == NULL);
+
+	// memalign() rounds a bad alignment up to the next power of two
+	ptr = memalign(48, 100);
+	assert(ptr != NULL && (uintptr_t)ptr % 64 == 0);
+	free(ptr);
+
+	long page = sysconf(_SC_PAGESIZE);
+	char *pages = valloc(10);
+	assert(pages != NULL && (uintptr_t)pages % page == 0);
+	free(pages);
+	pages = pvalloc(page + 1);
+	assert(pages != NULL && (uintptr_t)pages % page == 0);
+	memset(pages, 'p', page * 2);
+	free(pages);
+	pages = pvalloc(0);
+	assert(pages != NULL && (uintptr_t)pages % page == 0);
+	memset(pages, 'p', page);
+	free(pages);
+	ft_printf("PASSED: Aligned allocations\n");
+}
+
+// Test malloc_usable_size() and the sized frees
+void test_sized_free() {
+	ft_printf("Testing malloc_usable_size and sized frees...\n");
+
+	static const size_t sizes[] = {1, 24, 100, 129, 700, 1024, 5000, 300000};
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		char *ptr = malloc(sizes[i]);
+		assert(ptr != NULL);
+		// The whole usable size belongs to the block
+		size_t usable = malloc_usable_size(ptr);
+		assert(usable >= sizes[i]);
+		memset(ptr, 'u', usable);
+		free_sized(ptr, sizes[i]);
+
+		ptr = aligned_alloc(64, sizes[i]);
+		assert(ptr != NULL);
+		assert(malloc_usable_size(ptr) >= sizes[i]);
+		free_aligned_sized(ptr, 64, sizes[i]);
+	}
+	assert(malloc_usable_size(NULL) == 0);
+	free_sized(NULL, 10);
+
+	// A block shrunk in place by realloc() is freed with its new size
+	char *ptr = malloc(100);
+	assert(ptr != NULL);
+	ptr = realloc(ptr, 40);
+	assert(ptr != NULL && malloc_usable_size(ptr) >= 40);
+	free_sized(ptr, 40);
+	ptr = malloc(900);
+	assert(ptr != NULL);
+	ptr = realloc(ptr, 300);
+	assert(ptr != NULL);
+	free_sized(ptr, 300);
+	ft_printf("PASSED: Usable size and sized frees\n");
+}
+
+void test_batch() {
+	ft_printf("Testing malloc_batch and free_batch...\n");
+
+	static const size_t sizes[] = {16, 100, 700, 4000, 200000};
+	static void *ptrs[300];
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		size_t count = sizes[i] > 100000 ? 4 : 300;
+		assert(malloc_batch(sizes[i], count, ptrs) == count);
+		// Every block is distinct and writable in full
+		for (size_t j = 0; j < count; j++) {
+			assert(ptrs[j] != NULL && (uintptr_t)ptrs[j] % 16 == 0);
+			memset(ptrs[j], (int)j, sizes[i]);
+		}
+		for (size_t j = 0; j < count; j++)
+			assert(((unsigned char *)ptrs[j])[sizes[i] - 1] == (unsigned char)j);
+		// Mixed with the single-block calls both ways
+		free(ptrs[0]);
+		ptrs[0] = NULL;
+		ptrs[1] = realloc(ptrs[1], sizes[i] * 2);
+		assert(ptrs[1] != NULL);
+		free_batch(ptrs, count);
+	}
+	assert(malloc_batch(100, 0, ptrs) == 0);
+	free_batch(ptrs, 0);
+
+	// Blocks of different sizes and zones in one batch
+	for (int i = 0; i < 30; i++)
+		ptrs[i] = malloc((size_t)(i * 97) % 5000);
+	free_batch(ptrs, 30);
+	ft_printf("PASSED: Batch allocation and free\n");
+}
+
+void test_stats() {
+	ft_printf("Testing ft_malloc_stats, mallinfo2 and the JSON export...\n");
+
+	t_malloc_stats before = ft_malloc_stats();
+	char *large = malloc(300000);
+	assert(large != NULL);
+	t_malloc_stats during = ft_malloc_stats();
+	assert(during.large.zones == before.large.zones + 1);
+	assert(during.large.active >= before.large.active + 300000);
+	assert(during.total.mapped == during.tiny.mapped + during.small.mapped +
+	                                during.large.mapped);
+	// What is mapped is either handed out, free or metadata
+	assert(during.small.mapped == during.small.active + during.small.free +
+	                                during.small.metadata);
+	assert(during.small.fragmentation <= during.small.free);
+
+	struct mallinfo2 info = mallinfo2();
+	assert(info.hblks == during.large.zones);
+	assert(info.hblkhd == during.large.mapped);
+	assert(info.arena == during.tiny.mapped + during.small.mapped);
+	free(large);
+	assert(ft_malloc_stats().large.zones == before.large.zones);
+
+	char buffer[2048];
+	size_t length = ft_malloc_stats_json(buffer, sizeof(buffer));
+	assert(length > 0 && length < sizeof(buffer));
+	assert(strlen(buffer) == length && buffer[0] == '{');
+	assert(strstr(buffer, "\"small\":{\"zones\":") != NULL);
+	// Truncated like snprintf()
+	char small[16];
+	assert(ft_malloc_stats_json(small, sizeof(small)) >= sizeof(small));
+	assert(strlen(small) == sizeof(small) - 1);
+	assert(ft_malloc_stats_json(NULL, 0) > 0);
+	assert(ft_malloc_stats_json_fd(-1) == -1);
+	ft_printf("PASSED: Allocator statistics\n");
+}
+
 int main() {
 	ft_printf("=== BASIC MALLOC TESTS ===\n\n");
 
@@ -120,6 +309,10 @@ int main() {
 	test_calloc();
 	test_realloc();
 	test_allocation_sizes();
+	test_aligned();
+	test_sized_free();
+	test_batch();
+	test_stats();
 
 	ft_printf("\nAll basic tests passed!\n");
 	return 0;
@@ -0,0 +1,78 @@
+#include "malloc.h"
+#include <stdlib.h>
+#include <time.h>
+
+int ft_printf(char *string, ...);
+
+/* Blocks allocated then freed per size and batch, in rounds of one batch */
+#define OBJECTS 2000000
+#define MAX_BATCH 512
+
+static const int g_sizes[] = {48, 256, 1000, 4000};
+static const int g_batches[] = {1, 8, 64, MAX_BATCH};
+static void *g_ptrs[MAX_BATCH];
+
+static long long elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000000LL +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+// Time per object spent allocating, then freeing, one batch at a time
+static void run(int size, int batch, int batched, int *alloc_ns,
+                int *free_ns) {
+	struct timespec start, allocated, touched, end;
+	long long allocating = 0, freeing = 0;
+	int rounds = OBJECTS / batch;
+
+	for (int round = 0; round < rounds; round++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (batched) {
+			if (malloc_batch(size, batch, g_ptrs) != (size_t)batch)
+				exit(1);
+		} else {
+			for (int i = 0; i < batch; i++)
+				if (!(g_ptrs[i] = malloc(size)))
+					exit(1);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &allocated);
+		for (int i = 0; i < batch; i++)
+			*(char *)g_ptrs[i] = 'a';
+		clock_gettime(CLOCK_MONOTONIC, &touched);
+		if (batched)
+			free_batch(g_ptrs, batch);
+		else
+			for (int i = 0; i < batch; i++)
+				free(g_ptrs[i]);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		allocating += elapsed_ns(&start, &allocated);
+		freeing += elapsed_ns(&touched, &end);
+	}
+	*alloc_ns = (int)(allocating / ((long long)rounds * batch));
+	*free_ns = (int)(freeing / ((long long)rounds * batch));
+}
+
+int main() {
+	ft_printf("=== BATCH ALLOCATION BENCHMARK ===\n\n");
+	ft_printf("Rounds of one batch allocated then freed, %d objects per size "
+	          "and batch,\ntime per object (allocation + free)\n",
+	          OBJECTS);
+
+	for (size_t s = 0; s < sizeof(g_sizes) / sizeof(int); s++) {
+		ft_printf("\n%d bytes:\n", g_sizes[s]);
+		for (size_t b = 0; b < sizeof(g_batches) / sizeof(int); b++) {
+			int alloc_ns, free_ns, batch_alloc_ns, batch_free_ns;
+
+			// Warm the zones and caches up for this size
+			run(g_sizes[s], g_batches[b], 0, &alloc_ns, &free_ns);
+			run(g_sizes[s], g_batches[b], 0, &alloc_ns, &free_ns);
+			run(g_sizes[s], g_batches[b], 1, &batch_alloc_ns, &batch_free_ns);
+			ft_printf("  batch %d: malloc/free %d + %d ns, "
+			          "malloc_batch/free_batch %d + %d ns\n",
+			          g_batches[b], alloc_ns, free_ns, batch_alloc_ns,
+			          batch_free_ns);
+		}
+	}
+
+	ft_printf("\nBatch allocation benchmark completed!\n");
+	return 0;
+}
@@ -0,0 +1,54 @@
+#include "malloc.h"
+#include <stdlib.h>
+#include <time.h>
+
+int ft_printf(char *string, ...);
+
+#define PAGE 4096
+/* Bytes allocated per size, so every size does the same amount of work */
+#define VOLUME (1024L * 1024 * 1024)
+
+static const int g_sizes[] = {4096, 65536, 1048576, 16777216};
+
+static long long elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000000LL +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+// calloc, write one byte per page as a user would, then free
+void run_size(int size) {
+	struct timespec start, end;
+	int iterations = VOLUME / size;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < iterations; i++) {
+		char *buffer = calloc(1, size);
+		if (!buffer)
+			exit(1);
+		for (int j = 0; j < size; j += PAGE)
+			buffer[j] += 1;
+		free(buffer);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	long long ns = elapsed_ns(&start, &end);
+	ft_printf("  %d bytes: %d ns per calloc/touch/free (%d ms)\n", size,
+	          (int)(ns / iterations), (int)(ns / 1000000));
+}
+
+int main() {
+	ft_printf("=== CALLOC BENCHMARK ===\n\n");
+	ft_printf("calloc/touch/free loop, 1 GB allocated per size\n");
+
+	ft_printf("LARGE mappings reused from the cache:\n");
+	for (size_t i = 0; i < sizeof(g_sizes) / sizeof(int); i++)
+		run_size(g_sizes[i]);
+
+	ft_printf("Fresh LARGE mappings (cache disabled):\n");
+	ft_mallopt(FT_M_LARGE_CACHE_MAX, 0);
+	for (size_t i = 0; i < sizeof(g_sizes) / sizeof(int); i++)
+		run_size(g_sizes[i]);
+
+	ft_printf("\nCalloc benchmark completed!\n");
+	return 0;
+}
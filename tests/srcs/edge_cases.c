@@ -8,6 +8,10 @@ int ft_printf(char *string, ...);
 void test_null_pointers() {
 	ft_printf("Testing NULL pointer handling...\n");
 
+	// Freeing only NULLs should do nothing, even before any allocation
+	void *nulls[4] = {NULL, NULL, NULL, NULL};
+	free_batch(nulls, 4);
+
 	// Free NULL should do nothing
 	free(NULL);
 
@@ -92,6 +96,76 @@ void test_double_free() {
 	ft_printf("PASSED: Double free handling\n");
 }
 
+// Freeing again with free_sized() must not hand TINY objects out twice
+void test_double_free_sized() {
+	ft_printf("Testing double free_sized behavior...\n");
+
+	void *ptrs[40];
+	void *again[80];
+	for (int i = 0; i < 40; i++)
+		ptrs[i] = malloc(32);
+	for (int i = 0; i < 40; i++)
+		free(ptrs[i]);
+	for (int i = 0; i < 40; i++)
+		free_sized(ptrs[i], 32);
+
+	for (int i = 0; i < 80; i++) {
+		again[i] = malloc(32);
+		assert(again[i] != NULL);
+		for (int j = 0; j < i; j++)
+			assert(again[j] != again[i]);
+	}
+	for (int i = 0; i < 80; i++)
+		free(again[i]);
+
+	ft_printf("PASSED: Double free_sized handling\n");
+}
+
+// Whatever a TINY object holds must not decide whether its free is honoured
+void test_free_object_contents() {
+	ft_printf("Testing frees of objects holding allocator magics...\n");
+
+	void *first = malloc(32);
+	assert(first != NULL);
+	free(first);
+	for (int i = 0; i < 1000; i++) {
+		unsigned long *ptr = malloc(32);
+		// Freed right away, the object comes back from the thread cache
+		assert(ptr == first);
+		ptr[0] = 0xCAC4EB10;
+		ptr[1] = (i % 2) ? 0x4E307EF7 : 0xCAC4EB10;
+		free(ptr);
+	}
+
+	ft_printf("PASSED: Frees of objects holding allocator magics\n");
+}
+
+// Blocks merged by free_batch() must not be freed a second time
+void test_double_free_batch() {
+	ft_printf("Testing double free after free_batch...\n");
+
+	void *ptrs[40];
+	size_t count = malloc_batch(600, 40, ptrs);
+	assert(count == 40);
+	free_batch(ptrs, count);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuse-after-free"
+	for (size_t i = 0; i < count; i++)
+		free(ptrs[i]);
+#pragma GCC diagnostic pop
+
+	// The zone must still hand out sound blocks
+	for (size_t i = 0; i < count; i++) {
+		ptrs[i] = malloc(600);
+		assert(ptrs[i] != NULL);
+		((char *)ptrs[i])[599] = 1;
+	}
+	for (size_t i = 0; i < count; i++)
+		free(ptrs[i]);
+
+	ft_printf("PASSED: Double free after free_batch handling\n");
+}
+
 // Test invalid pointer to free
 void test_invalid_free() {
 	ft_printf("Testing invalid free behavior...\n");
@@ -132,6 +206,9 @@ int main() {
 	test_zero_size();
 	test_large_allocations();
 	test_double_free();
+	test_double_free_sized();
+	test_double_free_batch();
+	test_free_object_contents();
 	test_invalid_free();
 
 	ft_printf("\nAll edge case tests passed!\n");
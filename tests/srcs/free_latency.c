@@ -0,0 +1,65 @@
+#include "malloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int ft_printf(char *string, ...);
+
+#define LIVE_SLOTS 4096
+#define FREES 200000
+#define MIN_SIZE 129
+#define MAX_SIZE 1024
+
+static long long g_latencies[FREES];
+
+static long long now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int compare_latency(const void *a, const void *b) {
+	long long x = *(const long long *)a, y = *(const long long *)b;
+	return (x > y) - (x < y);
+}
+
+static void print_percentile(char *label, double ratio) {
+	size_t index = (size_t)(ratio * (FREES - 1));
+	ft_printf("  %s: %d ns\n", label, (int)g_latencies[index]);
+}
+
+int main() {
+	void *slots[LIVE_SLOTS] = {0};
+	unsigned int seed = 1234;
+	size_t frees = 0;
+
+	ft_printf("=== FREE LATENCY BENCHMARK ===\n\n");
+	ft_printf("Random SMALL churn over %d live blocks, %d timed frees\n",
+	          LIVE_SLOTS, FREES);
+
+	// Fill the heap so that frees land in fragmented zones
+	for (int i = 0; i < LIVE_SLOTS; i++)
+		slots[i] = malloc(rand_r(&seed) % (MAX_SIZE - MIN_SIZE) + MIN_SIZE);
+
+	while (frees < FREES) {
+		int slot = rand_r(&seed) % LIVE_SLOTS;
+		long long start = now_ns();
+		free(slots[slot]);
+		g_latencies[frees++] = now_ns() - start;
+		slots[slot] = malloc(rand_r(&seed) % (MAX_SIZE - MIN_SIZE) + MIN_SIZE);
+		if (slots[slot])
+			memset(slots[slot], 0, 16);
+	}
+
+	qsort(g_latencies, FREES, sizeof(long long), compare_latency);
+	print_percentile("p50", 0.50);
+	print_percentile("p99", 0.99);
+	print_percentile("p99.9", 0.999);
+	print_percentile("max", 1.0);
+
+	for (int i = 0; i < LIVE_SLOTS; i++)
+		free(slots[i]);
+	ft_printf("\nFree latency benchmark completed!\n");
+	return 0;
+}
@@ -0,0 +1,75 @@
+#include "malloc.h"
+#include <stdlib.h>
+#include <time.h>
+
+int ft_printf(char *string, ...);
+
+/* Blocks allocated then freed in total, in rounds of one batch */
+#define FREES 2000000
+#define MAX_BATCH 256
+
+static const int g_sizes[] = {32, 100, 500, 1000, 4096, 65536};
+/* A batch the thread cache holds, and one that makes it drain */
+static const int g_batches[] = {16, MAX_BATCH};
+static void *g_ptrs[MAX_BATCH];
+
+static long long elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000000LL +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+// Time spent in the frees only, per free
+static int run(int size, int batch, int sized) {
+	struct timespec start, end;
+	long long ns = 0;
+
+	for (int round = 0; round < FREES / batch; round++) {
+		for (int i = 0; i < batch; i++) {
+			g_ptrs[i] = malloc(size);
+			if (!g_ptrs[i])
+				exit(1);
+			*(char *)g_ptrs[i] = 'a';
+		}
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		if (sized)
+			for (int i = 0; i < batch; i++)
+				free_sized(g_ptrs[i], size);
+		else
+			for (int i = 0; i < batch; i++)
+				free(g_ptrs[i]);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		ns += elapsed_ns(&start, &end);
+	}
+	return (int)(ns / (FREES / batch * batch));
+}
+
+int main() {
+	ft_printf("=== SIZED FREE BENCHMARK ===\n\n");
+	ft_printf("Rounds of mallocs then frees, %d frees per size, time per "
+	          "free\n",
+	          FREES);
+
+	for (size_t b = 0; b < sizeof(g_batches) / sizeof(int); b++) {
+		ft_printf("\nBatches of %d:\n", g_batches[b]);
+		for (size_t i = 0; i < sizeof(g_sizes) / sizeof(int); i++) {
+			// Warm the zones and caches up for this size
+			run(g_sizes[i], g_batches[b], 0);
+			int plain = run(g_sizes[i], g_batches[b], 0);
+			int sized = run(g_sizes[i], g_batches[b], 1);
+			ft_printf("  %d bytes: free %d ns, free_sized %d ns\n", g_sizes[i],
+			          plain, sized);
+		}
+	}
+
+	// malloc_usable_size() reports the slack a buffer may grow into
+	ft_printf("\nUsable bytes per requested size:\n");
+	for (size_t i = 0; i < sizeof(g_sizes) / sizeof(int); i++) {
+		void *ptr = malloc(g_sizes[i] + 1);
+		ft_printf("  %d bytes: %d\n", g_sizes[i] + 1,
+		          (int)malloc_usable_size(ptr));
+		free(ptr);
+	}
+
+	ft_printf("\nSized free benchmark completed!\n");
+	return 0;
+}
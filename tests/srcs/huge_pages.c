@@ -0,0 +1,108 @@
+#include "malloc.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+int ft_printf(char *string, ...);
+
+#define HEAP_BYTES (256 * 1024 * 1024)
+#define SMALL_BLOCK 1000
+#define SMALL_COUNT (HEAP_BYTES / SMALL_BLOCK)
+#define LARGE_BLOCK (8 * 1024 * 1024)
+#define LARGE_COUNT (HEAP_BYTES / LARGE_BLOCK)
+#define ACCESSES (16 * 1024 * 1024)
+
+static char *g_small[SMALL_COUNT];
+static char *g_large[LARGE_COUNT];
+
+static long long elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000000LL +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+static uint64_t next_random(uint64_t *state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+/**
+ * Kilobytes of the process backed by transparent huge pages
+ */
+static int anon_huge_kb(void) {
+	char buffer[4096];
+	int fd = open("/proc/self/smaps_rollup", O_RDONLY);
+	if (fd < 0)
+		return -1;
+	ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	if (length <= 0)
+		return -1;
+	buffer[length] = '\0';
+
+	char *line = strstr(buffer, "AnonHugePages:");
+	if (!line)
+		return -1;
+	int kb = 0;
+	for (line += 14; *line == ' '; line++)
+		;
+	for (; *line >= '0' && *line <= '9'; line++)
+		kb = kb * 10 + (*line - '0');
+	return kb;
+}
+
+// Read-modify-write one word at a random offset of a random block
+static void run_heap(const char *name, char **blocks, int count, int size) {
+	struct timespec start, end;
+	uint64_t state = 0x9E3779B97F4A7C15ULL;
+	uint64_t sum = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < ACCESSES; i++) {
+		uint64_t random = next_random(&state);
+		char *block = blocks[random % count];
+		uint64_t *word =
+		  (uint64_t *)(block + ((random >> 32) % (size / 8)) * 8);
+		sum += ++*word;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	long long ns = elapsed_ns(&start, &end);
+	ft_printf("  %s: %d ns per access, %d M accesses/s (checksum %x)\n", name,
+	          (int)(ns / ACCESSES), (int)(ACCESSES * 1000LL / ns),
+	          (int)sum);
+}
+
+int main(int argc, char **argv) {
+	int huge = argc > 1 && !strcmp(argv[1], "huge");
+
+	ft_mallopt(FT_M_HUGE_PAGES, huge);
+	ft_printf("=== HUGE PAGES BENCHMARK (%s) ===\n\n",
+	          huge ? "huge pages" : "regular pages");
+
+	for (int i = 0; i < SMALL_COUNT; i++) {
+		g_small[i] = malloc(SMALL_BLOCK);
+		memset(g_small[i], 0, SMALL_BLOCK);
+	}
+	for (int i = 0; i < LARGE_COUNT; i++) {
+		g_large[i] = malloc(LARGE_BLOCK);
+		memset(g_large[i], 0, LARGE_BLOCK);
+	}
+	ft_printf("%d MB heap per zone type, %d M random accesses each\n",
+	          HEAP_BYTES / (1024 * 1024), ACCESSES / (1024 * 1024));
+
+	run_heap("SMALL 1000 bytes", g_small, SMALL_COUNT, SMALL_BLOCK);
+	run_heap("LARGE 8 MB", g_large, LARGE_COUNT, LARGE_BLOCK);
+	ft_printf("  transparent huge pages in use: %d kB\n", anon_huge_kb());
+
+	for (int i = 0; i < SMALL_COUNT; i++)
+		free(g_small[i]);
+	for (int i = 0; i < LARGE_COUNT; i++)
+		free(g_large[i]);
+
+	ft_printf("\nHuge pages benchmark completed!\n");
+	return 0;
+}
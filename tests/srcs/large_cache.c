@@ -0,0 +1,44 @@
+#include "malloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int ft_printf(char *string, ...);
+
+#define ITERATIONS 100000
+
+static const int g_sizes[] = {4096, 16384, 65536, 262144};
+
+static long long elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000000LL +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+// Allocate, touch and free one LARGE buffer per iteration
+void run_size(int size) {
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < ITERATIONS; i++) {
+		char *buffer = malloc(size);
+		if (buffer)
+			memset(buffer, i, 64);
+		free(buffer);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	long long ns = elapsed_ns(&start, &end);
+	ft_printf("  %d bytes: %d ns per malloc/free pair (%d ms)\n", size,
+	          (int)(ns / ITERATIONS), (int)(ns / 1000000));
+}
+
+int main() {
+	ft_printf("=== LARGE REUSE BENCHMARK ===\n\n");
+	ft_printf("malloc/touch/free loop, %d iterations per size\n", ITERATIONS);
+
+	for (size_t i = 0; i < sizeof(g_sizes) / sizeof(int); i++)
+		run_size(g_sizes[i]);
+
+	ft_printf("\nLARGE reuse benchmark completed!\n");
+	return 0;
+}
@@ -0,0 +1,133 @@
+#include "malloc.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+
+int ft_printf(char *string, ...);
+
+/* Bytes requested per size and alignment */
+#define VOLUME (8 * 1024 * 1024)
+#define MAX_COUNT (VOLUME / 64)
+
+static const int g_sizes[] = {64, 200, 1000, 3000, 16384, 100000};
+static const int g_alignments[] = {64, 4096};
+static void *g_ptrs[MAX_COUNT];
+
+typedef enum { PLAIN, PADDED, ALIGNED } t_method;
+
+static long long elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000000LL +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+/**
+ * Mapped and resident memory of the process in kB, from /proc/self/statm
+ */
+static void memory_kb(long *mapped, long *resident) {
+	char buffer[128];
+	long fields[2] = {0, 0};
+	int fd = open("/proc/self/statm", O_RDONLY);
+	ssize_t length = fd < 0 ? -1 : read(fd, buffer, sizeof(buffer) - 1);
+
+	if (fd >= 0)
+		close(fd);
+	buffer[length > 0 ? length : 0] = '\0';
+	char *field = buffer;
+	for (int i = 0; i < 2; i++) {
+		for (; *field >= '0' && *field <= '9'; field++)
+			fields[i] = fields[i] * 10 + (*field - '0');
+		if (*field == ' ')
+			field++;
+	}
+	*mapped = fields[0] * (sysconf(_SC_PAGESIZE) / 1024);
+	*resident = fields[1] * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Pointer to hand out for one request of the given method
+static void *allocate(t_method method, int alignment, int size) {
+	switch (method) {
+	case PLAIN:
+		return malloc(size);
+	case PADDED: {
+		// What callers do without memalign(): over-allocate, round up
+		char *raw = malloc(size + alignment);
+		return raw ? (void *)(((uintptr_t)raw + alignment - 1) &
+		                      ~(uintptr_t)(alignment - 1))
+		           : NULL;
+	}
+	case ALIGNED:
+	default:
+		return aligned_alloc(alignment, size);
+	}
+}
+
+static const char *g_names[] = {"malloc", "malloc + padding",
+                                "aligned_alloc"};
+
+// Growth over the requested bytes, in percent
+static int waste(long kb) {
+	return (int)((kb - VOLUME / 1024) * 100 / (VOLUME / 1024));
+}
+
+// In a child, so that every method starts from the same heap
+static void run(t_method method, int alignment, int size) {
+	int count = VOLUME / size;
+	struct timespec start, end;
+	long mapped_before, resident_before, mapped, resident;
+
+	memory_kb(&mapped_before, &resident_before);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < count; i++) {
+		g_ptrs[i] = allocate(method, alignment, size);
+		if (!g_ptrs[i] || (method != PLAIN &&
+		                   (uintptr_t)g_ptrs[i] % (uintptr_t)alignment)) {
+			ft_printf("    %s: allocation %d failed\n", g_names[method], i);
+			exit(1);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	// Make every page of every block resident
+	for (int i = 0; i < count; i++)
+		memset(g_ptrs[i], 'a', size);
+	memory_kb(&mapped, &resident);
+	mapped -= mapped_before;
+	resident -= resident_before;
+
+	ft_printf("    %s: mapped %d MB (+%d%s), resident %d MB (+%d%s), %d ns\n",
+	          g_names[method], (int)(mapped / 1024), waste(mapped), "%",
+	          (int)(resident / 1024), waste(resident), "%",
+	          (int)(elapsed_ns(&start, &end) / count));
+	exit(0);
+}
+
+static void run_child(t_method method, int alignment, int size) {
+	pid_t pid = fork();
+
+	if (pid == 0)
+		run(method, alignment, size);
+	waitpid(pid, NULL, 0);
+}
+
+int main() {
+	ft_printf("=== ALIGNED ALLOCATION BENCHMARK ===\n\n");
+	ft_printf("%d MB requested per size, every block touched, growth of the "
+	          "process\n(waste over the requested bytes) and time per "
+	          "allocation\n",
+	          VOLUME / (1024 * 1024));
+
+	for (size_t a = 0; a < sizeof(g_alignments) / sizeof(int); a++) {
+		ft_printf("\n%d-byte alignment:\n", g_alignments[a]);
+		for (size_t s = 0; s < sizeof(g_sizes) / sizeof(int); s++) {
+			ft_printf("  %d bytes:\n", g_sizes[s]);
+			run_child(PLAIN, g_alignments[a], g_sizes[s]);
+			run_child(PADDED, g_alignments[a], g_sizes[s]);
+			run_child(ALIGNED, g_alignments[a], g_sizes[s]);
+		}
+	}
+
+	ft_printf("\nAligned allocation benchmark completed!\n");
+	return 0;
+}
@@ -0,0 +1,202 @@
+#include "malloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+int ft_printf(char *string, ...);
+
+/* Allocator the benchmark is linked with, set to glibc by the Makefile */
+#ifndef ALLOCATOR
+#define ALLOCATOR "ft_malloc"
+#endif
+
+/* Rounds run before measuring, to map zones and fill the caches */
+#define WARMUP_ROUNDS 3
+/* Rounds measured per scenario */
+#define ROUNDS 15
+/* Operations per round, each on its own block */
+#define OPS 2000
+
+typedef enum e_op { OP_MALLOC, OP_FREE, OP_REALLOC, OP_CALLOC, OP_KINDS } t_op;
+
+static char *g_op_names[OP_KINDS] = {"malloc", "free", "realloc", "calloc"};
+
+/* One size per zone type; realloc() grows blocks by half, within the zone */
+static struct {
+	char *name;
+	size_t size;
+} g_zones[] = {{"tiny", 64}, {"small", 512}, {"large", 16384}};
+
+static void *g_ptrs[OPS];
+static unsigned long long g_samples[ROUNDS * OPS];
+static unsigned long long g_round_ticks[ROUNDS];
+static double g_ns_per_tick = 1;
+static unsigned long long g_timer_overhead;
+
+static unsigned long long now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * Time stamp counter where there is one, fenced so that the timed call
+ * neither starts before nor ends after it; nanoseconds elsewhere
+ */
+static inline unsigned long long ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	_mm_lfence();
+	unsigned long long now = __rdtsc();
+	_mm_lfence();
+	return now;
+#else
+	return now_ns();
+#endif
+}
+
+static int compare_ticks(const void *a, const void *b) {
+	unsigned long long x = *(const unsigned long long *)a;
+	unsigned long long y = *(const unsigned long long *)b;
+	return (x > y) - (x < y);
+}
+
+/**
+ * Measure the length of a tick against CLOCK_MONOTONIC, and the cost of
+ * reading the timer, subtracted from every sample
+ */
+static void calibrate(void) {
+	unsigned long long start_ns = now_ns(), start = ticks();
+	while (now_ns() - start_ns < 50000000)
+		;
+	g_ns_per_tick = (double)(now_ns() - start_ns) / (ticks() - start);
+
+	for (int i = 0; i < OPS; i++) {
+		unsigned long long before = ticks();
+		g_samples[i] = ticks() - before;
+	}
+	qsort(g_samples, OPS, sizeof(*g_samples), compare_ticks);
+	g_timer_overhead = g_samples[OPS / 2];
+}
+
+/* Blocks freed or resized by the timed operations are allocated first */
+static void prepare(t_op op, size_t size) {
+	if (op != OP_FREE && op != OP_REALLOC)
+		return;
+	for (int i = 0; i < OPS; i++) {
+		g_ptrs[i] = malloc(size);
+		*(char *)g_ptrs[i] = 1;
+	}
+}
+
+static void finish(t_op op) {
+	if (op == OP_FREE)
+		return;
+	for (int i = 0; i < OPS; i++)
+		free(g_ptrs[i]);
+}
+
+static inline void run(t_op op, size_t size, int i) {
+	switch (op) {
+	case OP_MALLOC:
+		g_ptrs[i] = malloc(size);
+		break;
+	case OP_FREE:
+		free(g_ptrs[i]);
+		break;
+	case OP_REALLOC:
+		g_ptrs[i] = realloc(g_ptrs[i], size + size / 2);
+		break;
+	default:
+		g_ptrs[i] = calloc(1, size);
+		break;
+	}
+}
+
+/**
+ * One round: OPS operations timed together for the throughput, then OPS
+ * operations timed one by one for the latencies, stored in samples
+ */
+static unsigned long long run_round(t_op op, size_t size,
+                                    unsigned long long *samples) {
+	prepare(op, size);
+	unsigned long long start = ticks();
+	for (int i = 0; i < OPS; i++)
+		run(op, size, i);
+	unsigned long long total = ticks() - start;
+	finish(op);
+
+	prepare(op, size);
+	for (int i = 0; i < OPS; i++) {
+		unsigned long long before = ticks();
+		run(op, size, i);
+		unsigned long long spent = ticks() - before;
+		samples[i] = spent > g_timer_overhead ? spent - g_timer_overhead : 0;
+	}
+	finish(op);
+	return total;
+}
+
+static int to_ns(unsigned long long ticks) {
+	return (int)(ticks * g_ns_per_tick + 0.5);
+}
+
+static int percentile_ns(int thousandths) {
+	return to_ns(g_samples[(ROUNDS * OPS - 1) * (size_t)thousandths / 1000]);
+}
+
+static void report(int json, t_op op, int zone) {
+	// Median of the rounds, in tenths of a nanosecond per operation
+	qsort(g_round_ticks, ROUNDS, sizeof(*g_round_ticks), compare_ticks);
+	int tenths =
+	  (int)(g_round_ticks[ROUNDS / 2] * g_ns_per_tick * 10 / OPS + 0.5);
+	qsort(g_samples, ROUNDS * OPS, sizeof(*g_samples), compare_ticks);
+
+	if (json)
+		ft_printf("{\"allocator\":\"%s\",\"op\":\"%s\",\"zone\":\"%s\","
+		          "\"size\":%d,\"rounds\":%d,\"ops_per_round\":%d,"
+		          "\"ns_per_op\":%d.%d,\"p50_ns\":%d,\"p99_ns\":%d,"
+		          "\"p999_ns\":%d}\n",
+		          ALLOCATOR, g_op_names[op], g_zones[zone].name,
+		          (int)g_zones[zone].size, ROUNDS, OPS, tenths / 10, tenths % 10,
+		          percentile_ns(500), percentile_ns(990), percentile_ns(999));
+	else
+		ft_printf("  %s %s (%d B): %d.%d ns/op, p50 %d ns, p99 %d ns, "
+		          "p99.9 %d ns\n",
+		          g_op_names[op], g_zones[zone].name, (int)g_zones[zone].size,
+		          tenths / 10, tenths % 10, percentile_ns(500),
+		          percentile_ns(990), percentile_ns(999));
+}
+
+int main(int argc, char **argv) {
+	int json = (argc > 1 && !strcmp(argv[1], "-j"));
+
+	calibrate();
+	if (!json) {
+		ft_printf("=== MICROBENCHMARKS: %s ===\n\n", ALLOCATOR);
+		ft_printf("%d warmup and %d measured rounds of %d operations per "
+		          "scenario\n",
+		          WARMUP_ROUNDS, ROUNDS, OPS);
+		ft_printf("Timer: %d ticks per us, %d ns of overhead subtracted from "
+		          "each sample\n\n",
+		          (int)(1000 / g_ns_per_tick + 0.5), to_ns(g_timer_overhead));
+	}
+
+	for (int zone = 0; zone < (int)(sizeof(g_zones) / sizeof(*g_zones));
+	     zone++)
+		for (t_op op = 0; op < OP_KINDS; op++) {
+			for (int round = 0; round < WARMUP_ROUNDS; round++)
+				run_round(op, g_zones[zone].size, g_samples);
+			for (int round = 0; round < ROUNDS; round++)
+				g_round_ticks[round] = run_round(op, g_zones[zone].size,
+				                                 g_samples + round * OPS);
+			report(json, op, zone);
+		}
+
+	if (!json)
+		ft_printf("\nMicrobenchmarks completed!\n");
+	return 0;
+}
@@ -0,0 +1,53 @@
+#include "malloc.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+int ft_printf(char *string, ...);
+
+#define OBJECTS 1000
+
+static const int g_sizes[] = {1,   8,   16,  24,  32,  48,  64,
+                               96,  128, 129, 160, 256, 512, 1000};
+
+/**
+ * Average distance between consecutive allocations of one size, taken over
+ * the longest run of increasing addresses so zone boundaries do not count
+ */
+size_t measure_stride(size_t size) {
+	void *ptrs[OBJECTS];
+	size_t best_span = 0, best_count = 0, run_start = 0;
+
+	for (int i = 0; i < OBJECTS; i++)
+		ptrs[i] = malloc(size);
+	for (int i = 1; i <= OBJECTS; i++) {
+		if (i == OBJECTS || (uintptr_t)ptrs[i] <= (uintptr_t)ptrs[i - 1] ||
+		    (uintptr_t)ptrs[i] - (uintptr_t)ptrs[i - 1] > 4096) {
+			size_t count = i - 1 - run_start;
+			if (count > best_count) {
+				best_count = count;
+				best_span = (uintptr_t)ptrs[i - 1] - (uintptr_t)ptrs[run_start];
+			}
+			run_start = i;
+		}
+	}
+	for (int i = 0; i < OBJECTS; i++)
+		free(ptrs[i]);
+	return best_count ? best_span / best_count : 0;
+}
+
+int main() {
+	ft_printf("=== PER-OBJECT OVERHEAD BENCHMARK ===\n\n");
+	ft_printf("size | bytes per object | overhead per object\n");
+
+	for (size_t i = 0; i < sizeof(g_sizes) / sizeof(int); i++) {
+		size_t stride = measure_stride(g_sizes[i]);
+		if (!stride)
+			ft_printf("%d | one zone per object\n", g_sizes[i]);
+		else
+			ft_printf("%d | %d | %d\n", g_sizes[i], (int)stride,
+			          (int)(stride - g_sizes[i]));
+	}
+
+	ft_printf("\nOverhead benchmark completed!\n");
+	return 0;
+}
@@ -0,0 +1,107 @@
+#include "malloc.h"
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+int ft_printf(char *string, ...);
+
+#define TINY_BLOCK 64
+#define TINY_COUNT (64 * 1024 * 1024 / TINY_BLOCK)
+#define SMALL_BLOCK 1000
+#define SMALL_COUNT (128 * 1024 * 1024 / SMALL_BLOCK)
+/* SMALL blocks freed in each run of RUN consecutive ones, the rest is kept */
+#define RUN 8
+/* FT_M_DECAY_TIME of the background run, in ms */
+#define DECAY_MS 1000
+
+static char *g_tiny[TINY_COUNT];
+static char *g_small[SMALL_COUNT];
+
+/**
+ * Value in kB of a field of /proc/self/smaps_rollup
+ */
+static int smaps_kb(const char *field) {
+	char buffer[4096];
+	int fd = open("/proc/self/smaps_rollup", O_RDONLY);
+	if (fd < 0)
+		return -1;
+	ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+	close(fd);
+	if (length <= 0)
+		return -1;
+	buffer[length] = '\0';
+
+	char *line = strstr(buffer, field);
+	if (!line)
+		return -1;
+	int kb = 0;
+	for (line += strlen(field); *line == ' '; line++)
+		;
+	for (; *line >= '0' && *line <= '9'; line++)
+		kb = kb * 10 + (*line - '0');
+	return kb;
+}
+
+// Memory the kernel cannot take back without asking: RSS minus lazy frees
+static void report(const char *phase) {
+	int rss = smaps_kb("Rss:");
+	int lazy = smaps_kb("LazyFree:");
+
+	ft_printf("  %s: RSS %d MB, lazily freed %d MB, resident %d MB\n", phase,
+	          rss / 1024, lazy / 1024, (rss - lazy) / 1024);
+}
+
+// Let the background thread work through one decay time and a half
+static void wait_decay(int background) {
+	if (!background)
+		return;
+	usleep(DECAY_MS * 1500);
+	report("  one decay time later");
+}
+
+int main(int argc, char **argv) {
+	int background = argc > 1 && !strcmp(argv[1], "background");
+
+	if (background) {
+		ft_mallopt(FT_M_BACKGROUND_THREAD, 1);
+		ft_mallopt(FT_M_DECAY_TIME, DECAY_MS);
+	}
+	ft_printf("=== PURGE BENCHMARK (%s) ===\n\n",
+	          background ? "background thread" : "inline");
+	ft_printf("%d MB of TINY and %d MB of SMALL blocks, then freed\n",
+	          TINY_COUNT * TINY_BLOCK / (1024 * 1024),
+	          SMALL_COUNT * SMALL_BLOCK / (1024 * 1024));
+	report("before the spike");
+
+	for (int i = 0; i < TINY_COUNT; i++) {
+		g_tiny[i] = malloc(TINY_BLOCK);
+		memset(g_tiny[i], 'T', TINY_BLOCK);
+	}
+	for (int i = 0; i < SMALL_COUNT; i++) {
+		g_small[i] = malloc(SMALL_BLOCK);
+		memset(g_small[i], 'S', SMALL_BLOCK);
+	}
+	report("at the peak");
+
+	// Every slab empties, SMALL zones keep one block per run
+	for (int i = 0; i < TINY_COUNT; i++)
+		free(g_tiny[i]);
+	for (int i = 0; i < SMALL_COUNT; i++)
+		if (i % RUN)
+			free(g_small[i]);
+	report("after freeing 7/8 of SMALL");
+	wait_decay(background);
+
+	for (int i = 0; i < SMALL_COUNT; i += RUN)
+		free(g_small[i]);
+	report("after freeing everything");
+	wait_decay(background);
+
+	if (!background) {
+		ft_malloc_maintenance();
+		report("after ft_malloc_maintenance");
+	}
+
+	ft_printf("\nPurge benchmark completed!\n");
+	return 0;
+}
@@ -0,0 +1,61 @@
+#include "malloc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int ft_printf(char *string, ...);
+
+#define START_SIZE 4096
+#define TARGET_SIZE (1024L * 1024 * 1024)
+#define PAGE 4096
+
+static long long elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000000LL +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+// Double a buffer up to TARGET_SIZE, writing one byte per new page
+int main() {
+	struct timespec start, end;
+	long long realloc_ns = 0;
+	size_t size = START_SIZE;
+	int steps = 0;
+
+	ft_printf("=== REALLOC GROWTH BENCHMARK ===\n\n");
+	ft_printf("Grow a buffer geometrically from %d bytes to 1 GB\n", START_SIZE);
+
+	char *buffer = malloc(size);
+	if (!buffer)
+		return 1;
+	memset(buffer, 'G', size);
+	while (size < TARGET_SIZE) {
+		size_t new_size = size * 2;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		char *grown = realloc(buffer, new_size);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		realloc_ns += elapsed_ns(&start, &end);
+		if (!grown) {
+			ft_printf("realloc to %d KB failed\n", (int)(new_size / 1024));
+			free(buffer);
+			return 1;
+		}
+		buffer = grown;
+		if (buffer[0] != 'G' || buffer[size - 1] != 'G') {
+			ft_printf("Data lost while growing to %d KB\n", (int)(new_size / 1024));
+			free(buffer);
+			return 1;
+		}
+		for (size_t offset = size; offset < new_size; offset += PAGE)
+			buffer[offset] = 'G';
+		buffer[new_size - 1] = 'G';
+		size = new_size;
+		steps++;
+	}
+	free(buffer);
+
+	ft_printf("  %d reallocs: %d ms in realloc, %d us per realloc\n", steps,
+	          (int)(realloc_ns / 1000000), (int)(realloc_ns / steps / 1000));
+	ft_printf("\nRealloc growth benchmark completed!\n");
+	return 0;
+}
@@ -0,0 +1,91 @@
+#include "malloc.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int ft_printf(char *string, ...);
+
+#define ITEMS_PER_PAIR 50000
+#define RING_SIZE 1024
+#define MAX_PAIRS 8
+
+static const int g_pair_counts[] = {1, 2, 4, 8};
+
+// Single-producer single-consumer ring handing pointers across threads
+typedef struct {
+	void *slots[RING_SIZE];
+	size_t head; // Next slot written by the producer
+	size_t tail; // Next slot read by the consumer
+} ring_t;
+
+static ring_t g_rings[MAX_PAIRS];
+
+void *remote_producer(void *arg) {
+	ring_t *ring = (ring_t *)arg;
+	unsigned int seed = (unsigned int)(ring - g_rings) + 1;
+
+	for (size_t i = 0; i < ITEMS_PER_PAIR; i++) {
+		size_t size = rand_r(&seed) % 2048 + 32;
+		void *ptr = malloc(size);
+		if (ptr)
+			memset(ptr, 'P', 16);
+
+		while (i - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= RING_SIZE)
+			sched_yield();
+		ring->slots[i % RING_SIZE] = ptr;
+		__atomic_store_n(&ring->head, i + 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+void *remote_consumer(void *arg) {
+	ring_t *ring = (ring_t *)arg;
+
+	for (size_t i = 0; i < ITEMS_PER_PAIR; i++) {
+		while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) <= i)
+			sched_yield();
+		free(ring->slots[i % RING_SIZE]);
+		__atomic_store_n(&ring->tail, i + 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+void run_pairs(int pairs) {
+	pthread_t producers[MAX_PAIRS], consumers[MAX_PAIRS];
+	struct timespec start, end;
+
+	memset(g_rings, 0, sizeof(g_rings));
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < pairs; i++) {
+		if (pthread_create(&consumers[i], NULL, remote_consumer, &g_rings[i]) ||
+		    pthread_create(&producers[i], NULL, remote_producer, &g_rings[i])) {
+			ft_printf("Failed to create thread pair %d\n", i);
+			return;
+		}
+	}
+	for (int i = 0; i < pairs; i++) {
+		pthread_join(producers[i], NULL);
+		pthread_join(consumers[i], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	long long ns = (end.tv_sec - start.tv_sec) * 1000000000LL +
+	               (end.tv_nsec - start.tv_nsec);
+	long long items = (long long)pairs * ITEMS_PER_PAIR;
+	ft_printf("  %d pairs: %d items/sec (%d ms)\n", pairs,
+	          (int)(items * 1000000000LL / (ns ? ns : 1)), (int)(ns / 1000000));
+}
+
+int main() {
+	ft_printf("=== PRODUCER/CONSUMER BENCHMARK ===\n\n");
+	ft_printf("Allocated by one thread, freed by another, %d items per pair\n",
+	          ITEMS_PER_PAIR);
+
+	for (size_t i = 0; i < sizeof(g_pair_counts) / sizeof(int); i++)
+		run_pairs(g_pair_counts[i]);
+
+	ft_printf("\nProducer/consumer benchmark completed!\n");
+	return 0;
+}
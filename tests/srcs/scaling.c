@@ -0,0 +1,76 @@
+#include "malloc.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int ft_printf(char *string, ...);
+
+#define OPS_PER_THREAD 200000
+#define LIVE_SLOTS 64
+#define MAX_SIZE 512
+
+static const int g_thread_counts[] = {1, 2, 4, 8, 16};
+
+// Each thread keeps a small working set and recycles it with TINY/SMALL sizes
+void *scaling_worker(void *arg) {
+	unsigned int seed = *(unsigned int *)arg;
+	void *slots[LIVE_SLOTS] = {0};
+
+	for (int i = 0; i < OPS_PER_THREAD; i++) {
+		int slot = rand_r(&seed) % LIVE_SLOTS;
+		if (slots[slot]) {
+			free(slots[slot]);
+			slots[slot] = NULL;
+		} else {
+			size_t size = rand_r(&seed) % MAX_SIZE + 1;
+			slots[slot] = malloc(size);
+			if (slots[slot])
+				memset(slots[slot], slot, size < 16 ? size : 16);
+		}
+	}
+
+	for (int i = 0; i < LIVE_SLOTS; i++)
+		free(slots[i]);
+	return NULL;
+}
+
+static long long elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000000LL +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+void run_scaling(int num_threads) {
+	pthread_t threads[16];
+	unsigned int seeds[16];
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < num_threads; i++) {
+		seeds[i] = i * 7919 + 1;
+		if (pthread_create(&threads[i], NULL, scaling_worker, &seeds[i]) != 0) {
+			ft_printf("Failed to create thread %d\n", i);
+			return;
+		}
+	}
+	for (int i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	long long ns = elapsed_ns(&start, &end);
+	long long ops = (long long)num_threads * OPS_PER_THREAD;
+	ft_printf("  %d threads: %d ops/sec (%d ms)\n", num_threads,
+	          (int)(ops * 1000000000LL / (ns ? ns : 1)), (int)(ns / 1000000));
+}
+
+int main() {
+	ft_printf("=== THREAD SCALING BENCHMARK ===\n\n");
+	ft_printf("Mixed TINY/SMALL malloc/free, %d ops per thread\n",
+	          OPS_PER_THREAD);
+
+	for (size_t i = 0; i < sizeof(g_thread_counts) / sizeof(int); i++)
+		run_scaling(g_thread_counts[i]);
+
+	ft_printf("\nScaling benchmark completed!\n");
+	return 0;
+}
@@ -0,0 +1,76 @@
+#include "malloc.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+int ft_printf(char *string, ...);
+
+/* Blocks live while the heap is reported */
+#define BLOCKS 100000
+
+static void *g_ptrs[BLOCKS];
+static volatile int g_running;
+static volatile long g_operations;
+
+static long long elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000000LL +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+// Another thread allocating meanwhile, held up while its arena is locked:
+// LARGE blocks always take the lock
+static void *allocate_loop(void *arg) {
+	(void)arg;
+	while (g_running) {
+		free(malloc(5000));
+		g_operations++;
+	}
+	return NULL;
+}
+
+static void run(const char *name, void (*show)(void)) {
+	int stdout_fd = dup(1);
+	int null_fd = open("/dev/null", O_WRONLY);
+	struct timespec start, end;
+	pthread_t thread;
+
+	g_running = 1;
+	pthread_create(&thread, NULL, allocate_loop, NULL);
+	// Let the thread bind its arena and warm its cache up
+	usleep(20000);
+	dup2(null_fd, 1);
+	long before = g_operations;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	show();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	long during = g_operations - before;
+	dup2(stdout_fd, 1);
+	g_running = 0;
+	pthread_join(thread, NULL);
+	close(null_fd);
+	close(stdout_fd);
+	ft_printf("  %s: %d us, %d malloc/free by another thread meanwhile\n",
+	          name, (int)(elapsed_ns(&start, &end) / 1000), (int)during);
+}
+
+int main() {
+	ft_printf("=== SHOW_ALLOC_MEM BENCHMARK ===\n\n");
+	for (int i = 0; i < BLOCKS; i++) {
+		g_ptrs[i] = malloc(i % 3 == 0 ? 48 : (i % 3 == 1 ? 500 : 3000));
+		if (!g_ptrs[i])
+			return 1;
+		memset(g_ptrs[i], 'a' + i % 26, 16);
+	}
+
+	ft_printf("%d blocks reported to /dev/null:\n", BLOCKS);
+	run("show_alloc_mem", show_alloc_mem);
+	run("show_alloc_mem_snapshot", show_alloc_mem_snapshot);
+	run("show_alloc_mem_ex", show_alloc_mem_ex);
+
+	for (int i = 0; i < BLOCKS; i++)
+		free(g_ptrs[i]);
+	ft_printf("\nShow benchmark completed!\n");
+	return 0;
+}
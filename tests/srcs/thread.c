@@ -1,4 +1,6 @@
 #include "malloc.h"
+#include <assert.h>
+#include <fcntl.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,6 +13,11 @@ int ft_printf(char *string, ...);
 #define ITERATIONS 5000
 #define ALLOC_SIZE 1024
 #define SHARED_ALLOCS 100
+// Blocks a thread cache holds per size class
+#define CACHE_FILL 16
+// Blocks handed from the producer to the consumer per round
+#define REMOTE_BLOCKS 64
+#define REMOTE_ROUNDS 50
 
 // Shared memory pointers for cross-thread tests
 void *shared_ptrs[SHARED_ALLOCS];
@@ -179,6 +186,179 @@ void run_producer_consumer_test() {
 	ft_printf("PASSED: cross-thread free test\n");
 }
 
+// Test 6: Heap reports taken while other threads allocate and free
+void run_report_test() {
+	ft_printf("Running reports during allocations test...\n");
+
+	pthread_t threads[NUM_THREADS];
+	int stdout_fd = dup(1);
+	int null_fd = open("/dev/null", O_WRONLY);
+
+	for (int i = 0; i < NUM_THREADS; i++) {
+		if (pthread_create(&threads[i], NULL, mixed_sizes_thread, NULL) != 0) {
+			ft_printf("Failed to create thread %d\n", i);
+			return;
+		}
+	}
+	dup2(null_fd, 1);
+	for (int i = 0; i < 20; i++) {
+		show_alloc_mem_snapshot();
+		show_alloc_mem();
+	}
+	dup2(stdout_fd, 1);
+	close(null_fd);
+	close(stdout_fd);
+
+	for (int i = 0; i < NUM_THREADS; i++)
+		pthread_join(threads[i], NULL);
+	ft_printf("PASSED: reports during allocations test\n");
+}
+
+// Test 7: A TINY object freed again by another thread is handed out once
+static void *double_free_thread(void *arg) {
+	free(arg);
+	return malloc(32);
+}
+
+void run_cross_thread_double_free_test() {
+	ft_printf("Running cross-thread double free test...\n");
+
+	pthread_t thread;
+	void *other = NULL;
+	void *ptr = malloc(32);
+	assert(ptr != NULL);
+	free(ptr);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuse-after-free"
+	pthread_create(&thread, NULL, double_free_thread, ptr);
+	pthread_join(thread, &other);
+
+	// Still parked in this thread's cache, not in the other thread's
+	void *mine = malloc(32);
+	assert(mine == ptr && other != ptr);
+#pragma GCC diagnostic pop
+	free(mine);
+	free(other);
+	ft_printf("PASSED: cross-thread double free test\n");
+}
+
+// Test 8: Blocks freed by another arena's thread are reused once drained
+static void *g_remote_blocks[REMOTE_BLOCKS];
+static pthread_barrier_t g_remote_barrier;
+
+static void *remote_producer_thread(void *arg) {
+	(void)arg;
+	for (int round = 0; round < REMOTE_ROUNDS; round++) {
+		// The first allocation of a round drains what the consumer queued
+		for (int i = 0; i < REMOTE_BLOCKS; i++)
+			g_remote_blocks[i] = malloc(600);
+		pthread_barrier_wait(&g_remote_barrier);
+		pthread_barrier_wait(&g_remote_barrier);
+	}
+	return NULL;
+}
+
+static void *remote_consumer_thread(void *arg) {
+	(void)arg;
+	for (int round = 0; round < REMOTE_ROUNDS; round++) {
+		pthread_barrier_wait(&g_remote_barrier);
+		for (int i = 0; i < REMOTE_BLOCKS; i++)
+			free(g_remote_blocks[i]);
+		pthread_barrier_wait(&g_remote_barrier);
+	}
+	return NULL;
+}
+
+void run_remote_reuse_test() {
+	ft_printf("Running remote free reuse test...\n");
+
+	pthread_t producer, consumer;
+	size_t before = ft_malloc_stats().small.mapped;
+
+	// Threads get consecutive arenas: the two never share one
+	pthread_barrier_init(&g_remote_barrier, NULL, 2);
+	pthread_create(&producer, NULL, remote_producer_thread, NULL);
+	pthread_create(&consumer, NULL, remote_consumer_thread, NULL);
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+	pthread_barrier_destroy(&g_remote_barrier);
+
+	// Without reuse, every round would map room for all of its blocks
+	size_t grown = ft_malloc_stats().small.mapped - before;
+	assert(grown < (size_t)REMOTE_ROUNDS * REMOTE_BLOCKS * 600 / 4);
+	ft_printf("PASSED: remote free reuse test\n");
+}
+
+// Test 9: Remote double frees of a SMALL block and a TINY object are ignored
+static void *remote_double_free_thread(void *arg) {
+	void **victims = arg;
+	size_t sizes[2] = {600, 48};
+
+	for (int v = 0; v < 2; v++) {
+		void *fill[CACHE_FILL];
+		void *twice[2] = {victims[v], victims[v]};
+
+		// With this thread's cache full, free_batch() hands the victim
+		// straight to its arena's remote list
+		for (int i = 0; i < CACHE_FILL; i++)
+			fill[i] = malloc(sizes[v]);
+		for (int i = 0; i < CACHE_FILL; i++)
+			free(fill[i]);
+		free_batch(twice, 2);
+	}
+	return NULL;
+}
+
+void run_remote_double_free_test() {
+	ft_printf("Running remote double free test...\n");
+
+	size_t sizes[2] = {600, 48};
+	// One of two consecutive threads is bound to another arena than this one
+	for (int t = 0; t < 2; t++) {
+		pthread_t thread;
+		void *victims[2] = {malloc(sizes[0]), malloc(sizes[1])};
+
+		pthread_create(&thread, NULL, remote_double_free_thread, victims);
+		pthread_join(thread, NULL);
+		for (int v = 0; v < 2; v++) {
+			void *ptrs[REMOTE_BLOCKS];
+
+			for (int i = 0; i < REMOTE_BLOCKS; i++) {
+				ptrs[i] = malloc(sizes[v]);
+				for (int j = 0; j < i; j++)
+					assert(ptrs[j] != ptrs[i]);
+			}
+			for (int i = 0; i < REMOTE_BLOCKS; i++)
+				free(ptrs[i]);
+		}
+	}
+	ft_printf("PASSED: remote double free test\n");
+}
+
+// Test 10: A zone whose last block is freed remotely does not stay mapped
+static void *free_thread(void *arg) {
+	free(arg);
+	return NULL;
+}
+
+void run_remote_release_test() {
+	ft_printf("Running remote zone release test...\n");
+
+	for (int t = 0; t < 2; t++) {
+		pthread_t thread;
+		size_t before = ft_malloc_stats().large.zones;
+		void *ptr = malloc(1 << 20);
+
+		assert(ft_malloc_stats().large.zones == before + 1);
+		pthread_create(&thread, NULL, free_thread, ptr);
+		pthread_join(thread, NULL);
+		// Missing this thread's cache, the allocation drains the remote list
+		free(malloc(900 + t * 16));
+		assert(ft_malloc_stats().large.zones == before);
+	}
+	ft_printf("PASSED: remote zone release test\n");
+}
+
 int main() {
 	ft_printf("=== THREAD SAFETY TESTS ===\n\n");
 
@@ -191,6 +371,11 @@ int main() {
 	run_producer_consumer_test();
 	run_thread_test(contention_thread, "High contention test");
 	run_thread_test(mixed_sizes_thread, "Mixed allocation sizes");
+	run_report_test();
+	run_cross_thread_double_free_test();
+	run_remote_reuse_test();
+	run_remote_double_free_test();
+	run_remote_release_test();
 
 	// Show memory state after all tests
 	ft_printf("\n=== MEMORY STATE AFTER THREAD TESTS ===\n");
@@ -0,0 +1,179 @@
+#include "malloc.h"
+#include "trace.h"
+#include "trace_file.h"
+#include <assert.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+int ft_printf(char *string, ...);
+
+// Two threads of the traced process, then the main thread of its fork
+#define SCRIPTS 3
+#define FORKED_SCRIPT 2
+// Rounds of five operations: several times the 4096 records of a ring
+#define SCRIPT_ROUNDS 3000
+#define SCRIPT_RECORDS (SCRIPT_ROUNDS * 5 + 2)
+// Size of the first allocation of each script, which no round requests
+#define MARKER_SIZE 77777
+
+// What each script did, shared between the traced processes and the checker
+typedef struct s_script {
+	pid_t process;
+	uint32_t thread;
+	size_t count;
+	t_trace_record records[SCRIPT_RECORDS];
+} t_script;
+
+t_script *g_scripts;
+
+static void expect(t_script *script, t_trace_op op, uintptr_t ptr,
+                   size_t size, uintptr_t arg) {
+	t_trace_record *record = &script->records[script->count++];
+
+	record->op = op;
+	record->ptr = ptr;
+	record->size = size;
+	record->arg = arg;
+	record->thread = script->thread;
+}
+
+// Known operations, remembered as the records they should leave
+void *run_script(void *arg) {
+	t_script *script = &g_scripts[(intptr_t)arg];
+
+	script->process = getpid();
+	script->thread = (uint32_t)syscall(SYS_gettid);
+	void *marker = malloc(MARKER_SIZE);
+	expect(script, TRACE_MALLOC, (uintptr_t)marker, MARKER_SIZE, 0);
+	for (int i = 0; i < SCRIPT_ROUNDS; i++) {
+		size_t size = 1 + (i * 37 + (intptr_t)arg * 101) % 2000;
+
+		void *ptr = malloc(size);
+		expect(script, TRACE_MALLOC, (uintptr_t)ptr, size, 0);
+		void *zeroed = calloc(2, size);
+		expect(script, TRACE_CALLOC, (uintptr_t)zeroed, 2 * size, 0);
+		uintptr_t old = (uintptr_t)ptr;
+		void *resized = realloc(ptr, size + 16);
+		expect(script, TRACE_REALLOC, (uintptr_t)resized, size + 16, old);
+		expect(script, TRACE_FREE_SIZED, (uintptr_t)zeroed, 2 * size, 0);
+		free_sized(zeroed, 2 * size);
+		expect(script, TRACE_FREE, (uintptr_t)resized, 0, 0);
+		free(resized);
+	}
+	expect(script, TRACE_FREE, (uintptr_t)marker, 0, 0);
+	free(marker);
+	return NULL;
+}
+
+// Traced process: two threads at once, then a fork running a third script
+void run_traced_process() {
+	pthread_t threads[FORKED_SCRIPT];
+
+	for (intptr_t i = 0; i < FORKED_SCRIPT; i++)
+		assert(pthread_create(&threads[i], NULL, run_script, (void *)i) == 0);
+	for (int i = 0; i < FORKED_SCRIPT; i++)
+		pthread_join(threads[i], NULL);
+
+	pid_t pid = fork();
+	assert(pid >= 0);
+	if (pid == 0) {
+		run_script((void *)FORKED_SCRIPT);
+		exit(0);
+	}
+	int status;
+	assert(waitpid(pid, &status, 0) == pid);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	exit(0);
+}
+
+static int same_record(t_trace_record *record, t_trace_record *expected) {
+	return record->op == expected->op && record->ptr == expected->ptr &&
+	       record->size == expected->size && record->arg == expected->arg &&
+	       record->thread == expected->thread && record->reserved == 0;
+}
+
+/**
+ * The records of the script's thread, from its marker on, must be exactly
+ * the operations it made, in order and with their times in order; thread
+ * creation and exit add records of their own around them
+ */
+static void check_script(t_trace_record *records, size_t count,
+                         t_script *script) {
+	size_t matched = 0;
+	uint64_t last_time = 0;
+
+	for (size_t i = 0; i < count && matched < script->count; i++) {
+		if (records[i].thread != script->thread)
+			continue;
+		if (!matched && !same_record(&records[i], &script->records[0]))
+			continue;
+		assert(same_record(&records[i], &script->records[matched]));
+		assert(records[i].time >= last_time);
+		last_time = records[i].time;
+		matched++;
+	}
+	assert(matched == script->count);
+}
+
+/**
+ * Load the trace file of a process and check the scripts it ran; it must
+ * hold no record of the threads of any other process
+ */
+static void check_trace_file(const char *prefix, pid_t pid) {
+	char path[256];
+	size_t count;
+
+	snprintf(path, sizeof(path), "%s.%d.trace", prefix, pid);
+	t_trace_record *records = trace_load(path, &count);
+	assert(records != NULL);
+
+	int scripts = 0;
+	for (int i = 0; i < SCRIPTS; i++) {
+		if (g_scripts[i].process == pid) {
+			check_script(records, count, &g_scripts[i]);
+			scripts++;
+			continue;
+		}
+		for (size_t j = 0; j < count; j++)
+			assert(records[j].thread != g_scripts[i].thread);
+	}
+	assert(scripts > 0);
+	ft_printf("%s: %d records, %d scripts checked\n", path, (int)count,
+	          scripts);
+	free(records);
+	unlink(path);
+}
+
+int main() {
+	const char *prefix = getenv("FT_MALLOC_TRACE");
+
+	ft_printf("=== TRACE TESTS ===\n\n");
+	if (!prefix || !*prefix)
+		prefix = "ft_malloc";
+
+	g_scripts = mmap(NULL, SCRIPTS * sizeof(t_script), PROT_READ | PROT_WRITE,
+	                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	assert(g_scripts != MAP_FAILED);
+
+	pid_t pid = fork();
+	assert(pid >= 0);
+	if (pid == 0)
+		run_traced_process();
+	int status;
+	assert(waitpid(pid, &status, 0) == pid);
+	assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+	check_trace_file(prefix, g_scripts[0].process);
+	check_trace_file(prefix, g_scripts[FORKED_SCRIPT].process);
+	munmap(g_scripts, SCRIPTS * sizeof(t_script));
+
+	ft_printf("PASSED: Trace records of two threads and a fork\n");
+	ft_printf("\nAll trace tests completed successfully!\n");
+	return 0;
+}
@@ -0,0 +1,57 @@
+#include "malloc.h"
+#include <stdlib.h>
+#include <time.h>
+
+int ft_printf(char *string, ...);
+
+#define LIVE_ZONES 10000
+#define LARGE_SIZE 2048
+#define ROUNDS 3
+
+static void *g_ptrs[LIVE_ZONES];
+
+static long long elapsed_ns(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) * 1000000000LL +
+	       (end->tv_nsec - start->tv_nsec);
+}
+
+// Fisher-Yates shuffle so frees do not follow the allocation order
+void shuffle(unsigned int *seed) {
+	for (int i = LIVE_ZONES - 1; i > 0; i--) {
+		int j = rand_r(seed) % (i + 1);
+		void *tmp = g_ptrs[i];
+		g_ptrs[i] = g_ptrs[j];
+		g_ptrs[j] = tmp;
+	}
+}
+
+void run_round(int round, unsigned int *seed) {
+	struct timespec start, end;
+
+	// Every LARGE allocation lives in a zone of its own
+	for (int i = 0; i < LIVE_ZONES; i++)
+		g_ptrs[i] = malloc(LARGE_SIZE);
+	shuffle(seed);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int i = 0; i < LIVE_ZONES; i++)
+		free(g_ptrs[i]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	long long ns = elapsed_ns(&start, &end);
+	ft_printf("  round %d: %d ns per free (%d ms)\n", round,
+	          (int)(ns / LIVE_ZONES), (int)(ns / 1000000));
+}
+
+int main() {
+	unsigned int seed = 42;
+
+	ft_printf("=== ZONE LOOKUP BENCHMARK ===\n\n");
+	ft_printf("Free %d live LARGE zones in random order\n", LIVE_ZONES);
+
+	for (int i = 1; i <= ROUNDS; i++)
+		run_round(i, &seed);
+
+	ft_printf("\nZone lookup benchmark completed!\n");
+	return 0;
+}
@@ -0,0 +1,105 @@
+#include "trace_file.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Print the trace file written by a debug build of the library, in time
+ * order, or a summary of it with -s
+ *
+ * Usage: trace_decode [-s] ft_malloc.<pid>.trace
+ */
+
+/* Distinct threads counted by the summary */
+#define TRACE_MAX_THREADS 4096
+
+static const char *g_op_names[TRACE_OPS] = {
+  [TRACE_MALLOC] = "malloc",
+  [TRACE_CALLOC] = "calloc",
+  [TRACE_FREE] = "free",
+  [TRACE_FREE_SIZED] = "free_sized",
+  [TRACE_MALLOC_BATCH] = "malloc_batch",
+  [TRACE_FREE_BATCH] = "free_batch",
+  [TRACE_POSIX_MEMALIGN] = "posix_memalign",
+  [TRACE_ALIGNED_ALLOC] = "aligned_alloc",
+  [TRACE_MEMALIGN] = "memalign",
+  [TRACE_VALLOC] = "valloc",
+  [TRACE_PVALLOC] = "pvalloc",
+  [TRACE_REALLOC] = "realloc",
+};
+
+static const char *op_name(uint16_t op) {
+	return op < TRACE_OPS ? g_op_names[op] : "unknown";
+}
+
+static void print_records(t_trace_record *records, size_t count) {
+	uint64_t start = count ? records[0].time : 0;
+
+	for (size_t i = 0; i < count; i++) {
+		t_trace_record *record = &records[i];
+		uint64_t time = record->time - start;
+
+		printf("%" PRIu64 ".%09" PRIu64 " [%" PRIu32 "] %s(%#" PRIx64,
+		       time / 1000000000, time % 1000000000, record->thread,
+		       op_name(record->op), record->ptr);
+		if (record->size)
+			printf(", %" PRIu64 " bytes", record->size);
+		if (record->op == TRACE_REALLOC)
+			printf(", from %#" PRIx64, record->arg);
+		else if (record->arg)
+			printf(", aligned on %" PRIu64, record->arg);
+		printf(")\n");
+	}
+}
+
+static void print_summary(t_trace_record *records, size_t count) {
+	size_t calls[TRACE_OPS + 1] = {0};
+	size_t failed[TRACE_OPS + 1] = {0};
+	uint64_t bytes[TRACE_OPS + 1] = {0};
+	uint32_t seen[TRACE_MAX_THREADS];
+	size_t threads = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		size_t op = records[i].op < TRACE_OPS ? records[i].op : TRACE_OPS;
+
+		calls[op]++;
+		bytes[op] += records[i].size;
+		if (!records[i].ptr)
+			failed[op]++;
+		size_t j = 0;
+		while (j < threads && seen[j] != records[i].thread)
+			j++;
+		if (j == threads && threads < TRACE_MAX_THREADS)
+			seen[threads++] = records[i].thread;
+	}
+
+	uint64_t duration = count ? records[count - 1].time - records[0].time : 0;
+	printf("%zu records, %zu threads, %" PRIu64 ".%09" PRIu64 " s\n", count,
+	       threads, duration / 1000000000, duration % 1000000000);
+	printf("%-16s %12s %12s %16s\n", "operation", "calls", "null", "bytes");
+	for (size_t op = 0; op <= TRACE_OPS; op++)
+		if (calls[op])
+			printf("%-16s %12zu %12zu %16" PRIu64 "\n", op_name(op), calls[op],
+			       failed[op], bytes[op]);
+}
+
+int main(int argc, char **argv) {
+	int summary = (argc == 3 && !strcmp(argv[1], "-s"));
+	size_t count;
+
+	if (argc != 2 + summary) {
+		fprintf(stderr, "usage: %s [-s] trace_file\n", argv[0]);
+		return 2;
+	}
+
+	t_trace_record *records = trace_load(argv[1 + summary], &count);
+	if (!records)
+		return 1;
+	if (summary)
+		print_summary(records, count);
+	else
+		print_records(records, count);
+	free(records);
+	return 0;
+}
@@ -0,0 +1,84 @@
+#include "bool.h"
+#include "trace_file.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Record and its position in the file, where each thread's records are in
+ * the order the thread made them
+ */
+typedef struct s_entry {
+	t_trace_record record;
+	size_t position;
+} t_entry;
+
+static int compare_entries(const void *a, const void *b) {
+	const t_entry *left = a;
+	const t_entry *right = b;
+
+	if (left->record.time != right->record.time)
+		return left->record.time < right->record.time ? -1 : 1;
+	return left->position < right->position ? -1 : 1;
+}
+
+/**
+ * Sort the records by time, keeping the order of the records of a thread
+ */
+static t_bool sort_records(t_trace_record *records, size_t count) {
+	t_entry *entries = malloc(count * sizeof(t_entry) + 1);
+
+	if (!entries)
+		return false;
+	for (size_t i = 0; i < count; i++) {
+		entries[i].record = records[i];
+		entries[i].position = i;
+	}
+	qsort(entries, count, sizeof(t_entry), compare_entries);
+	for (size_t i = 0; i < count; i++)
+		records[i] = entries[i].record;
+	free(entries);
+	return true;
+}
+
+t_trace_record *trace_load(const char *path, size_t *count) {
+	FILE *file = fopen(path, "rb");
+	t_trace_header header;
+
+	if (!file) {
+		perror(path);
+		return NULL;
+	}
+	if (fread(&header, sizeof(header), 1, file) != 1 ||
+	    memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) ||
+	    header.version != TRACE_VERSION ||
+	    header.record_size != sizeof(t_trace_record)) {
+		fprintf(stderr, "%s: not a version %d trace file\n", path, TRACE_VERSION);
+		fclose(file);
+		return NULL;
+	}
+
+	size_t capacity = 4096;
+	t_trace_record *records = malloc(capacity * sizeof(t_trace_record));
+	*count = 0;
+	while (records) {
+		*count += fread(records + *count, sizeof(t_trace_record),
+		                capacity - *count, file);
+		if (*count < capacity)
+			break;
+		capacity *= 2;
+		t_trace_record *grown =
+		  realloc(records, capacity * sizeof(t_trace_record));
+		if (!grown)
+			free(records);
+		records = grown;
+	}
+	fclose(file);
+	if (!records || !sort_records(records, *count)) {
+		fprintf(stderr, "%s: out of memory\n", path);
+		free(records);
+		return NULL;
+	}
+	return records;
+}
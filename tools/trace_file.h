@@ -0,0 +1,13 @@
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+#include "trace.h"
+#include <stddef.h>
+
+/**
+ * Read every record of a trace file, sorted by time; the records of a
+ * thread keep the order the thread made them in
+ * Returns NULL, after printing why, if the file cannot be read
+ */
+t_trace_record *trace_load(const char *path, size_t *count);
+
+#endif
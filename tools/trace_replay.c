@@ -0,0 +1,550 @@
+#define _GNU_SOURCE
+#include "bool.h"
+#include "malloc.h"
+#include "trace_file.h"
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Run the operations of a trace again, one thread per traced thread, against
+ * the allocator the tool runs with: glibc, or this library when preloaded
+ *
+ * Usage: [LD_PRELOAD=./libft_malloc.so] trace_replay [-j] trace_file
+ *
+ * Each block freed or resized by a thread other than the one allocating it
+ * is waited for, so that a thread never gets ahead of the traced order.
+ * Batches are replayed one block at a time and free_sized() as free(), so
+ * that glibc runs the same operations.
+ */
+
+/* Slot of a block that is neither allocated nor freed by an operation */
+#define NO_SLOT SIZE_MAX
+
+/**
+ * Operation to replay, the blocks being numbered in allocation order
+ */
+typedef struct s_op {
+	uint16_t op;     /* t_trace_op */
+	uint32_t thread; /* Traced thread id */
+	size_t size;     /* Size to request */
+	size_t align;    /* Alignment of the aligned allocations */
+	size_t from;     /* Block freed or resized */
+	size_t to;       /* Block allocated */
+} t_op;
+
+/**
+ * Traced thread and what replaying it measured
+ */
+typedef struct s_thread {
+	uint32_t id;
+	t_op *ops;
+	size_t count;
+	uint64_t *latency; /* Nanoseconds, per operation */
+	size_t failed;     /* Allocations failing where the traced one did not */
+	pthread_t handle;
+} t_thread;
+
+/**
+ * Open addressing table from a traced pointer to the blocks it is live for,
+ * oldest first, or from a thread id to its thread
+ */
+typedef struct s_entry {
+	uint64_t key;
+	size_t head;
+	size_t tail;
+} t_entry;
+
+typedef struct s_table {
+	t_entry *entries;
+	size_t capacity;
+	size_t used;
+} t_table;
+
+/**
+ * Latencies of one kind of operation
+ */
+typedef enum e_kind { KIND_MALLOC, KIND_CALLOC, KIND_ALIGNED, KIND_REALLOC,
+	                    KIND_FREE, KINDS } t_kind;
+
+static const char *g_kind_names[KINDS] = {"malloc", "calloc", "aligned",
+                                          "realloc", "free"};
+
+/* Percentiles reported, in thousandths */
+static const unsigned int g_percentiles[] = {500, 900, 990, 999};
+
+static void **g_blocks;
+/* Stored in g_blocks for an allocation that failed during the replay */
+static char g_failed_block;
+static pthread_barrier_t g_start;
+
+static uint64_t now_ns(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static t_entry *table_find(t_table *table, uint64_t key) {
+	size_t mask = table->capacity - 1;
+	size_t index = (key * 0x9E3779B97F4A7C15ULL >> 17) & mask;
+
+	while (table->entries[index].key && table->entries[index].key != key)
+		index = (index + 1) & mask;
+	return &table->entries[index];
+}
+
+/**
+ * Get the entry of key, added empty if there is none
+ * Keys are never 0, which marks the unused entries
+ */
+static t_entry *table_get(t_table *table, uint64_t key) {
+	if ((table->used + 1) * 2 > table->capacity) {
+		t_table grown = {calloc(table->capacity * 2, sizeof(t_entry)),
+		                 table->capacity * 2, table->used};
+		if (!grown.entries) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+		for (size_t i = 0; i < table->capacity; i++)
+			if (table->entries[i].key)
+				*table_find(&grown, table->entries[i].key) = table->entries[i];
+		free(table->entries);
+		*table = grown;
+	}
+
+	t_entry *entry = table_find(table, key);
+	if (!entry->key) {
+		entry->key = key;
+		entry->head = NO_SLOT;
+		entry->tail = NO_SLOT;
+		table->used++;
+	}
+	return entry;
+}
+
+/*
+ * A pointer can be live for two blocks at once in a trace: an allocation
+ * returning it may be recorded before the realloc() that moved it away
+ * returns. The free that follows goes to the oldest block.
+ */
+
+static void live_push(t_table *live, size_t *next, uint64_t ptr, size_t block) {
+	t_entry *entry = table_get(live, ptr);
+
+	next[block] = NO_SLOT;
+	if (entry->tail == NO_SLOT)
+		entry->head = block;
+	else
+		next[entry->tail] = block;
+	entry->tail = block;
+}
+
+static size_t live_pop(t_table *live, size_t *next, uint64_t ptr) {
+	t_entry *entry = table_get(live, ptr);
+	size_t block = entry->head;
+
+	if (block != NO_SLOT) {
+		entry->head = next[block];
+		if (entry->head == NO_SLOT)
+			entry->tail = NO_SLOT;
+	}
+	return block;
+}
+
+/* Put back a block whose realloc() failed, still the oldest for its pointer */
+static void live_unpop(t_table *live, size_t *next, uint64_t ptr,
+                       size_t block) {
+	t_entry *entry = table_get(live, ptr);
+
+	next[block] = entry->head;
+	entry->head = block;
+	if (entry->tail == NO_SLOT)
+		entry->tail = block;
+}
+
+static t_bool is_allocation(uint16_t op) {
+	return op == TRACE_MALLOC || op == TRACE_CALLOC ||
+	       op == TRACE_MALLOC_BATCH || op == TRACE_POSIX_MEMALIGN ||
+	       op == TRACE_ALIGNED_ALLOC || op == TRACE_MEMALIGN ||
+	       op == TRACE_VALLOC || op == TRACE_PVALLOC;
+}
+
+/**
+ * Turn the records into operations on numbered blocks, dropping what
+ * cannot be replayed: failed allocations, and frees of pointers the trace
+ * never returned
+ */
+static t_op *build_ops(t_trace_record *records, size_t count, size_t *ops,
+                       size_t *blocks) {
+	t_op *list = malloc(count * sizeof(t_op) + 1);
+	size_t *next = malloc(count * sizeof(size_t) + 1);
+	t_table live = {calloc(1024, sizeof(t_entry)), 1024, 0};
+
+	if (!list || !next || !live.entries) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	*ops = 0;
+	*blocks = 0;
+	for (size_t i = 0; i < count; i++) {
+		t_trace_record *record = &records[i];
+		t_op op = {record->op, record->thread, record->size, record->arg,
+		           NO_SLOT, NO_SLOT};
+
+		if (is_allocation(record->op)) {
+			if (!record->ptr)
+				continue;
+			if (op.op == TRACE_MALLOC_BATCH)
+				op.op = TRACE_MALLOC;
+			op.to = (*blocks)++;
+			live_push(&live, next, record->ptr, op.to);
+		} else if (record->op == TRACE_REALLOC) {
+			op.align = 0;
+			if (record->arg)
+				op.from = live_pop(&live, next, record->arg);
+			if (!record->ptr && record->size && op.from != NO_SLOT) {
+				live_unpop(&live, next, record->arg, op.from);
+				continue;
+			}
+			if (!record->ptr) {
+				// realloc(ptr, 0) freed ptr
+				if (op.from == NO_SLOT)
+					continue;
+				op.op = TRACE_FREE;
+			} else {
+				op.to = (*blocks)++;
+				live_push(&live, next, record->ptr, op.to);
+			}
+		} else {
+			if (!record->ptr)
+				continue;
+			op.op = TRACE_FREE;
+			op.size = 0;
+			op.from = live_pop(&live, next, record->ptr);
+			if (op.from == NO_SLOT)
+				continue;
+		}
+		list[(*ops)++] = op;
+	}
+	free(next);
+	free(live.entries);
+	return list;
+}
+
+static t_kind op_kind(uint16_t op) {
+	switch (op) {
+	case TRACE_MALLOC:
+		return KIND_MALLOC;
+	case TRACE_CALLOC:
+		return KIND_CALLOC;
+	case TRACE_REALLOC:
+		return KIND_REALLOC;
+	case TRACE_FREE:
+		return KIND_FREE;
+	default:
+		return KIND_ALIGNED;
+	}
+}
+
+static void *run_op(t_op *op) {
+	void *from = (op->from == NO_SLOT) ? NULL : g_blocks[op->from];
+	void *block = NULL;
+
+	if (from == &g_failed_block)
+		from = NULL;
+	switch (op->op) {
+	case TRACE_MALLOC:
+		return malloc(op->size);
+	case TRACE_CALLOC:
+		return calloc(1, op->size);
+	case TRACE_POSIX_MEMALIGN:
+		return posix_memalign(&block, op->align, op->size) ? NULL : block;
+	case TRACE_ALIGNED_ALLOC:
+		return aligned_alloc(op->align, op->size);
+	case TRACE_MEMALIGN:
+		return memalign(op->align, op->size);
+	case TRACE_VALLOC:
+		return valloc(op->size);
+	case TRACE_PVALLOC:
+		return pvalloc(op->size);
+	case TRACE_REALLOC:
+		return realloc(from, op->size);
+	default:
+		free(from);
+		return NULL;
+	}
+}
+
+static void *replay_thread(void *arg) {
+	t_thread *thread = arg;
+	size_t page = sysconf(_SC_PAGESIZE);
+
+	pthread_barrier_wait(&g_start);
+	for (size_t i = 0; i < thread->count; i++) {
+		t_op *op = &thread->ops[i];
+
+		// Wait for a block allocated by another thread
+		while (op->from != NO_SLOT &&
+		       !__atomic_load_n(&g_blocks[op->from], __ATOMIC_ACQUIRE))
+			sched_yield();
+		uint64_t start = now_ns();
+		char *block = run_op(op);
+		thread->latency[i] = now_ns() - start;
+		if (op->to == NO_SLOT)
+			continue;
+		if (!block) {
+			thread->failed++;
+			block = &g_failed_block;
+		} else {
+			// Like the traced program, use the pages handed out
+			for (size_t offset = 0; offset < op->size; offset += page)
+				block[offset] = 1;
+		}
+		__atomic_store_n(&g_blocks[op->to], block, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+/**
+ * Deal the operations out to their threads, in the order of their first
+ * operation
+ */
+static t_thread *split_threads(t_op *ops, size_t count, size_t *threads) {
+	t_table ids = {calloc(64, sizeof(t_entry)), 64, 0};
+	t_thread *list = calloc(count + 1, sizeof(t_thread));
+
+	if (!ids.entries || !list) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+	*threads = 0;
+	for (size_t i = 0; i < count; i++) {
+		// Thread ids of 0 do not occur, so they can be table keys
+		t_entry *entry = table_get(&ids, ops[i].thread);
+		if (entry->head == NO_SLOT) {
+			entry->head = (*threads)++;
+			list[entry->head].id = ops[i].thread;
+		}
+		list[entry->head].count++;
+	}
+	for (size_t i = 0; i < *threads; i++) {
+		list[i].ops = malloc(list[i].count * sizeof(t_op) + 1);
+		list[i].latency = malloc(list[i].count * sizeof(uint64_t) + 1);
+		if (!list[i].ops || !list[i].latency) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+		// Touched now, so that the peak RSS measured is the allocator's
+		memset(list[i].latency, 0, list[i].count * sizeof(uint64_t));
+		list[i].count = 0;
+	}
+	for (size_t i = 0; i < count; i++) {
+		t_thread *thread = &list[table_find(&ids, ops[i].thread)->head];
+
+		thread->ops[thread->count++] = ops[i];
+	}
+	free(ids.entries);
+	return list;
+}
+
+static int compare_latencies(const void *a, const void *b) {
+	uint64_t left = *(const uint64_t *)a;
+	uint64_t right = *(const uint64_t *)b;
+
+	return (left > right) - (left < right);
+}
+
+/**
+ * Field of /proc/self/status, in kB, or 0 if it cannot be read
+ */
+static size_t status_kb(const char *field) {
+	char buffer[4096];
+	int fd = open("/proc/self/status", O_RDONLY);
+	ssize_t length = fd >= 0 ? read(fd, buffer, sizeof(buffer) - 1) : -1;
+
+	if (fd >= 0)
+		close(fd);
+	if (length <= 0)
+		return 0;
+	buffer[length] = '\0';
+	char *line = strstr(buffer, field);
+	return line ? strtoul(line + strlen(field), NULL, 10) : 0;
+}
+
+/**
+ * Bring the peak RSS of the process down to its current RSS (Linux 4.0)
+ */
+static t_bool reset_peak_rss(void) {
+	int fd = open("/proc/self/clear_refs", O_WRONLY);
+	t_bool done = fd >= 0 && write(fd, "5", 1) == 1;
+
+	if (fd >= 0)
+		close(fd);
+	return done;
+}
+
+/**
+ * Latencies of one kind of operation, sorted
+ */
+typedef struct s_latencies {
+	uint64_t *values;
+	size_t count;
+} t_latencies;
+
+static void gather_latencies(t_thread *threads, size_t count,
+                             t_latencies *kinds) {
+	for (size_t i = 0; i < count; i++)
+		for (size_t j = 0; j < threads[i].count; j++)
+			kinds[op_kind(threads[i].ops[j].op)].count++;
+	for (size_t kind = 0; kind < KINDS; kind++) {
+		kinds[kind].values = malloc(kinds[kind].count * sizeof(uint64_t) + 1);
+		if (!kinds[kind].values) {
+			fprintf(stderr, "out of memory\n");
+			exit(1);
+		}
+		kinds[kind].count = 0;
+	}
+	for (size_t i = 0; i < count; i++)
+		for (size_t j = 0; j < threads[i].count; j++) {
+			t_latencies *kind = &kinds[op_kind(threads[i].ops[j].op)];
+			kind->values[kind->count++] = threads[i].latency[j];
+		}
+	for (size_t kind = 0; kind < KINDS; kind++)
+		qsort(kinds[kind].values, kinds[kind].count, sizeof(uint64_t),
+		      compare_latencies);
+}
+
+static uint64_t percentile(t_latencies *kind, unsigned int thousandths) {
+	if (!kind->count)
+		return 0;
+	return kind->values[(kind->count - 1) * thousandths / 1000];
+}
+
+/**
+ * Summary of a replay
+ */
+typedef struct s_report {
+	const char *allocator;
+	size_t threads;
+	size_t ops;
+	size_t failed;
+	uint64_t wall_ns;
+	size_t baseline_kb; /* RSS of the tool before the replay */
+	size_t peak_kb;     /* Peak RSS during the replay, 0 if unknown */
+	t_latencies kinds[KINDS];
+} t_report;
+
+static void print_text(t_report *report) {
+	printf("allocator:  %s\n", report->allocator);
+	printf("threads:    %zu\n", report->threads);
+	printf("operations: %zu (%zu allocations failed)\n", report->ops,
+	       report->failed);
+	printf("wall time:  %.3f ms, %.0f operations/s\n", report->wall_ns / 1e6,
+	       report->ops / (report->wall_ns / 1e9));
+	if (report->peak_kb)
+		printf("peak RSS:   %zu kB, %zu kB above the replay's own data\n",
+		       report->peak_kb, report->peak_kb - report->baseline_kb);
+	else
+		printf("peak RSS:   unknown\n");
+	printf("\n%-10s %10s %8s %8s %8s %8s %10s\n", "latency ns", "count", "p50",
+	       "p90", "p99", "p99.9", "max");
+	for (size_t kind = 0; kind < KINDS; kind++) {
+		t_latencies *latencies = &report->kinds[kind];
+
+		if (!latencies->count)
+			continue;
+		printf("%-10s %10zu", g_kind_names[kind], latencies->count);
+		for (size_t i = 0; i < sizeof(g_percentiles) / sizeof(*g_percentiles);
+		     i++)
+			printf(" %8" PRIu64, percentile(latencies, g_percentiles[i]));
+		printf(" %10" PRIu64 "\n", latencies->values[latencies->count - 1]);
+	}
+}
+
+static void print_json(t_report *report) {
+	printf("{\"allocator\":\"%s\",\"threads\":%zu,\"operations\":%zu,"
+	       "\"failed\":%zu,\"wall_ns\":%" PRIu64 ",\"baseline_rss_kb\":%zu,"
+	       "\"peak_rss_kb\":%zu,\"latency_ns\":{",
+	       report->allocator, report->threads, report->ops, report->failed,
+	       report->wall_ns, report->baseline_kb, report->peak_kb);
+	for (size_t kind = 0, first = 1; kind < KINDS; kind++) {
+		t_latencies *latencies = &report->kinds[kind];
+
+		if (!latencies->count)
+			continue;
+		printf("%s\"%s\":{\"count\":%zu", first ? "" : ",", g_kind_names[kind],
+		       latencies->count);
+		for (size_t i = 0; i < sizeof(g_percentiles) / sizeof(*g_percentiles);
+		     i++)
+			printf(",\"p%g\":%" PRIu64, g_percentiles[i] / 10.0,
+			       percentile(latencies, g_percentiles[i]));
+		printf(",\"max\":%" PRIu64 "}", latencies->values[latencies->count - 1]);
+		first = 0;
+	}
+	printf("}}\n");
+}
+
+int main(int argc, char **argv) {
+	int json = (argc == 3 && !strcmp(argv[1], "-j"));
+	t_report report = {0};
+	size_t count, blocks;
+
+	if (argc != 2 + json) {
+		fprintf(stderr, "usage: %s [-j] trace_file\n", argv[0]);
+		return 2;
+	}
+	if (getenv("FT_MALLOC_TRACE"))
+		fprintf(stderr, "warning: FT_MALLOC_TRACE is set, the replay is traced\n");
+
+	t_trace_record *records = trace_load(argv[1 + json], &count);
+	if (!records)
+		return 1;
+	t_op *ops = build_ops(records, count, &report.ops, &blocks);
+	free(records);
+	t_thread *threads = split_threads(ops, report.ops, &report.threads);
+	free(ops);
+	g_blocks = malloc(blocks * sizeof(void *) + 1);
+	if (!g_blocks) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	memset(g_blocks, 0, blocks * sizeof(void *));
+	report.allocator =
+	  dlsym(RTLD_DEFAULT, "show_alloc_mem") ? "ft_malloc" : "glibc";
+
+	// Threads are all started before the clock starts
+	pthread_barrier_init(&g_start, NULL, report.threads + 1);
+	for (size_t i = 0; i < report.threads; i++)
+		if (pthread_create(&threads[i].handle, NULL, replay_thread,
+		                   &threads[i])) {
+			fprintf(stderr, "cannot create thread %zu\n", i);
+			return 1;
+		}
+	t_bool peak_known = reset_peak_rss();
+	report.baseline_kb = status_kb("VmRSS:");
+	// Taken first: woken up, the threads may run before this one
+	uint64_t start = now_ns();
+	pthread_barrier_wait(&g_start);
+	for (size_t i = 0; i < report.threads; i++)
+		pthread_join(threads[i].handle, NULL);
+	report.wall_ns = now_ns() - start;
+	report.peak_kb = peak_known ? status_kb("VmHWM:") : 0;
+
+	for (size_t i = 0; i < report.threads; i++)
+		report.failed += threads[i].failed;
+	gather_latencies(threads, report.threads, report.kinds);
+	if (json)
+		print_json(&report);
+	else
+		print_text(&report);
+	return 0;
+}